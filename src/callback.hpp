@@ -0,0 +1,553 @@
+#ifndef UVCPP_CALLBACK_H_
+#define UVCPP_CALLBACK_H_
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef UVCPP_CALLBACK_INLINE_SIZE
+#define UVCPP_CALLBACK_INLINE_SIZE (4 * sizeof(void *))
+#endif
+
+#ifndef UVCPP_CALLBACK_INLINE_SLOTS
+#ifdef UVCPP_COMPACT_HANDLES
+#define UVCPP_CALLBACK_INLINE_SLOTS 0
+#else
+#define UVCPP_CALLBACK_INLINE_SLOTS 8
+#endif
+#endif
+
+namespace uvcpp {
+
+  /**
+   * move-only type erased event callback, callables that fit in
+   * UVCPP_CALLBACK_INLINE_SIZE bytes are stored inline, larger ones
+   * fall back to the heap
+   */
+  class ErasedCallback {
+    static constexpr std::size_t kInlineSize = UVCPP_CALLBACK_INLINE_SIZE;
+
+    using Invoker = void (*)(void *storage, const void *event, void *owner);
+    // moves the callable from src into dst and destroys src,
+    // only destroys src if dst is nullptr
+    using Manager = void (*)(void *dst, void *src);
+
+    template <typename F>
+    struct FitsInline : std::integral_constant<bool,
+      sizeof(F) <= kInlineSize &&
+      alignof(F) <= alignof(void *) &&
+      std::is_nothrow_move_constructible<F>::value> { };
+
+    template <typename F, bool = FitsInline<F>::value>
+    struct Storage {
+      static F *get(void *s) {
+        return reinterpret_cast<F *>(s);
+      }
+
+      template <typename G>
+      static void create(void *s, G &&g) {
+        new (s) F(std::forward<G>(g));
+      }
+
+      static void manage(void *dst, void *src) {
+        auto f = get(src);
+        if (dst) {
+          new (dst) F(std::move(*f));
+        }
+        f->~F();
+      }
+    };
+
+    template <typename F>
+    struct Storage<F, false> {
+      static F *get(void *s) {
+        return *reinterpret_cast<F **>(s);
+      }
+
+      template <typename G>
+      static void create(void *s, G &&g) {
+        *reinterpret_cast<F **>(s) = new F(std::forward<G>(g));
+      }
+
+      static void manage(void *dst, void *src) {
+        if (dst) {
+          *reinterpret_cast<F **>(dst) = get(src);
+        } else {
+          delete get(src);
+        }
+      }
+    };
+
+    public:
+      ErasedCallback() = default;
+      ErasedCallback(const ErasedCallback &) = delete;
+      ErasedCallback &operator=(const ErasedCallback &) = delete;
+
+      ErasedCallback(ErasedCallback &&other) noexcept {
+        moveFrom(other);
+      }
+
+      ErasedCallback &operator=(ErasedCallback &&other) noexcept {
+        if (this != &other) {
+          reset();
+          moveFrom(other);
+        }
+        return *this;
+      }
+
+      ~ErasedCallback() {
+        reset();
+      }
+
+      /**
+       * wraps a callable of signature void(const E &, Owner &)
+       */
+      template <typename E, typename Owner, typename F>
+      static ErasedCallback create(F &&f) {
+        using Fn = std::decay_t<F>;
+        ErasedCallback cb;
+        Storage<Fn>::create(&cb.storage_, std::forward<F>(f));
+        cb.invoker_ = invoke<E, Owner, Fn>;
+        cb.manager_ = Storage<Fn>::manage;
+        return cb;
+      }
+
+      void operator()(const void *event, void *owner) {
+        invoker_(&storage_, event, owner);
+      }
+
+      explicit operator bool() const {
+        return invoker_ != nullptr;
+      }
+
+      void reset() {
+        if (manager_) {
+          manager_(nullptr, &storage_);
+          invoker_ = nullptr;
+          manager_ = nullptr;
+        }
+      }
+
+    private:
+      template <typename E, typename Owner, typename F>
+      static void invoke(void *s, const void *event, void *owner) {
+        (*Storage<F>::get(s))(
+          *static_cast<const E *>(event), *static_cast<Owner *>(owner));
+      }
+
+      void moveFrom(ErasedCallback &other) {
+        if (other.manager_) {
+          other.manager_(&storage_, &other.storage_);
+          invoker_ = other.invoker_;
+          manager_ = other.manager_;
+          other.invoker_ = nullptr;
+          other.manager_ = nullptr;
+        }
+      }
+
+    private:
+      typename std::aligned_storage<kInlineSize, alignof(void *)>::type storage_;
+      Invoker invoker_{nullptr};
+      Manager manager_{nullptr};
+  };
+
+  /**
+   * compile time list of the events a Resource publishes, see EventTraits
+   */
+  template <typename ...E>
+  struct EventList {
+    static constexpr std::size_t size = sizeof...(E);
+  };
+
+  /**
+   * index of E in the EventList, equals to the size of the list if E
+   * is not in the list
+   */
+  template <typename E, typename List>
+  struct EventIndex;
+
+  template <typename E>
+  struct EventIndex<E, EventList<>> :
+    std::integral_constant<std::size_t, 0> { };
+
+  template <typename E, typename Head, typename ...Tail>
+  struct EventIndex<E, EventList<Head, Tail...>> :
+    std::integral_constant<std::size_t,
+      std::is_same<E, Head>::value ?
+      0 : 1 + EventIndex<E, EventList<Tail...>>::value> { };
+
+  /**
+   * returned by Resource::on()/once(), pass it to Resource::off() to
+   * remove the callback. a Subscription becomes stale once its callback
+   * is removed or, for ONCE callbacks, called.
+   */
+  class Subscription {
+    template <std::size_t, std::size_t> friend class CallbackStore;
+
+    public:
+      Subscription() = default;
+
+    private:
+      Subscription(const void *store, void *slot, std::uint32_t generation) :
+        store_(store), slot_(slot), generation_(generation) { }
+
+      const void *store_{nullptr};
+      void *slot_{nullptr};
+      std::uint32_t generation_{0};
+  };
+
+  /**
+   * callbacks of all event types of a Resource live in one slot store,
+   * the first InlineSlots slots are embedded in the store itself, more
+   * slots are added in chunks that never move, so a callback can safely
+   * register or remove callbacks while it is being called. slots of fired
+   * ONCE callbacks and removed callbacks are reused by later registrations.
+   *
+   * the first ListedEvents event ids have a flat table of per-event slot
+   * lists, dispatching them only visits their own slots; other event ids
+   * are found by scanning all slots. either way the callables are called
+   * through ErasedCallback, their types are only known where they are
+   * registered, the calls that can be inlined are the ones of the static
+   * handlers, see Stream::readStart(Handler &).
+   */
+  template <
+    std::size_t InlineSlots = UVCPP_CALLBACK_INLINE_SLOTS,
+    std::size_t ListedEvents = 0>
+  class CallbackStore {
+    enum Flag : std::uint8_t {
+      USED    = 1,
+      ONCE    = 2,
+      // registered while a dispatch is in progress, the slot will not
+      // be called until the outermost dispatch finishes
+      PENDING = 4,
+      // released but still linked in an event list, it is unlinked
+      // when no dispatch is in progress
+      ZOMBIE  = 8,
+      // removed while a dispatch is in progress, the callable may still
+      // be running, it is destroyed when the outermost dispatch finishes
+      REMOVED = 16,
+    };
+
+    struct Slot {
+      ErasedCallback callback;
+      Slot *next{nullptr};
+      std::uint32_t generation{0};
+      std::uint16_t eventId{0};
+      std::uint8_t flags{0};
+    };
+
+    struct Chunk {
+      explicit Chunk(std::size_t capacity) :
+        slots(new Slot[capacity]), capacity(capacity) { }
+      std::unique_ptr<Slot[]> slots;
+      std::size_t capacity;
+      std::size_t used{0};
+      std::unique_ptr<Chunk> next{nullptr};
+    };
+
+    struct EventSlots {
+      Slot *head{nullptr};
+      Slot *tail{nullptr};
+    };
+
+    static constexpr std::size_t kMinChunkSlots = 4;
+
+    // holds ONCE callbacks taken out of the store while they are called
+    class OnceBatch {
+      static constexpr std::size_t kInlineCount = 4;
+
+      public:
+        void push(ErasedCallback &&cb) {
+          if (count_ < kInlineCount) {
+            inline_[count_] = std::move(cb);
+          } else {
+            overflow_.push_back(std::move(cb));
+          }
+          ++count_;
+        }
+
+        void invoke(const void *event, void *owner) {
+          for (std::size_t i = 0; i < count_; ++i) {
+            if (i < kInlineCount) {
+              inline_[i](event, owner);
+            } else {
+              overflow_[i - kInlineCount](event, owner);
+            }
+          }
+        }
+
+      private:
+        std::array<ErasedCallback, kInlineCount> inline_{};
+        std::vector<ErasedCallback> overflow_{};
+        std::size_t count_{0};
+    };
+
+    public:
+      CallbackStore() = default;
+      CallbackStore(const CallbackStore &) = delete;
+      CallbackStore &operator=(const CallbackStore &) = delete;
+
+      template <typename E, typename Owner, typename F>
+      Subscription add(std::uint32_t eventId, bool once, F &&f) {
+        auto slot = acquire();
+        slot->callback =
+          ErasedCallback::template create<E, Owner>(std::forward<F>(f));
+        slot->eventId = static_cast<std::uint16_t>(eventId);
+        ++slot->generation;
+        slot->flags = USED | (once ? ONCE : 0);
+        if (depth_ > 0) {
+          slot->flags |= PENDING;
+          ++pendingCount_;
+        }
+        ++(once ? onceCount_ : alwaysCount_);
+
+        if (eventId < ListedEvents) {
+          auto &list = lists_[eventId];
+          slot->next = nullptr;
+          if (list.tail) {
+            list.tail->next = slot;
+          } else {
+            list.head = slot;
+          }
+          list.tail = slot;
+        }
+        return Subscription{ this, slot, slot->generation };
+      }
+
+      /**
+       * O(1), the callable is destroyed right away unless a dispatch is in
+       * progress, in which case it is destroyed when the outermost dispatch
+       * finishes, so a callback can remove itself
+       */
+      bool remove(const Subscription &sub) {
+        auto s = static_cast<Slot *>(sub.slot_);
+        if (sub.store_ != this || !s ||
+            !(s->flags & USED) || s->generation != sub.generation_) {
+          return false;
+        }
+
+        if (depth_ > 0) {
+          --((s->flags & ONCE) ? onceCount_ : alwaysCount_);
+          if (s->flags & PENDING) {
+            --pendingCount_;
+          }
+          s->flags = REMOVED;
+          ++removedCount_;
+          return true;
+        }
+
+        // destroyed last, it may hold the last reference to the owner
+        auto callback = std::move(s->callback);
+        release(*s);
+        return true;
+      }
+
+      /**
+       * removes every callback, as remove() does, the callables are
+       * destroyed after the store is settled, since one of them may hold
+       * the last reference to the owner
+       */
+      void clear() {
+        std::vector<ErasedCallback> removed;
+        forEachSlot([this, &removed](Slot &s){
+          if (!(s.flags & USED)) {
+            return;
+          }
+          if (depth_ > 0) {
+            --((s.flags & ONCE) ? onceCount_ : alwaysCount_);
+            if (s.flags & PENDING) {
+              --pendingCount_;
+            }
+            s.flags = REMOVED;
+            ++removedCount_;
+          } else {
+            removed.push_back(std::move(s.callback));
+            release(s);
+          }
+        });
+        if (depth_ == 0) {
+          settle();
+        }
+      }
+
+      void dispatch(std::uint32_t eventId, const void *event, void *owner) {
+        if (alwaysCount_ == 0) {
+          return;
+        }
+
+        ++depth_;
+        forEachSlotOf(eventId, [&](Slot &s){
+          if (s.flags == USED) {
+            s.callback(event, owner);
+          }
+        });
+        if (--depth_ == 0) {
+          settle();
+        }
+      }
+
+      /**
+       * ONCE callbacks are moved out of the store before any of them is
+       * called, the callables are destroyed after the last one returns,
+       * which may in turn destroy the owner of this store (a callback
+       * that holds the last shared_ptr to its handle), so nothing of the
+       * store is touched after that
+       */
+      void dispatchOnce(std::uint32_t eventId, const void *event, void *owner) {
+        if (onceCount_ == 0) {
+          return;
+        }
+
+        OnceBatch batch;
+        forEachSlotOf(eventId, [&](Slot &s){
+          if (s.flags == (USED | ONCE)) {
+            batch.push(std::move(s.callback));
+            release(s);
+          }
+        });
+        if (depth_ == 0) {
+          settle();
+        }
+        batch.invoke(event, owner);
+      }
+
+    private:
+      template <typename Fn>
+      void forEachSlot(Fn &&fn) {
+        for (std::size_t i = 0; i < inlineUsed_; ++i) {
+          fn(inline_[i]);
+        }
+        for (auto c = overflow_.get(); c; c = c->next.get()) {
+          for (std::size_t i = 0; i < c->used; ++i) {
+            fn(c->slots[i]);
+          }
+        }
+      }
+
+      template <typename Fn>
+      void forEachSlotOf(std::uint32_t eventId, Fn &&fn) {
+        if (eventId < ListedEvents) {
+          for (auto s = lists_[eventId].head; s; s = s->next) {
+            fn(*s);
+          }
+        } else {
+          forEachSlot([&](Slot &s){
+            if (s.eventId == eventId) {
+              fn(s);
+            }
+          });
+        }
+      }
+
+      Slot *acquire() {
+        if (freeCount_ == 0 && zombieCount_ > 0 && depth_ == 0) {
+          settle();
+        }
+
+        if (freeCount_ > 0) {
+          Slot *freeSlot = nullptr;
+          forEachSlot([&freeSlot](Slot &s){
+            if (!freeSlot && s.flags == 0) {
+              freeSlot = &s;
+            }
+          });
+          --freeCount_;
+          return freeSlot;
+        }
+
+        if (inlineUsed_ < InlineSlots) {
+          return &inline_[inlineUsed_++];
+        }
+
+        if (!tail_ || tail_->used == tail_->capacity) {
+          auto chunk = std::make_unique<Chunk>(
+            tail_ ? tail_->capacity * 2 :
+            (InlineSlots > kMinChunkSlots ? InlineSlots : kMinChunkSlots));
+          auto rawChunk = chunk.get();
+          if (tail_) {
+            tail_->next = std::move(chunk);
+          } else {
+            overflow_ = std::move(chunk);
+          }
+          tail_ = rawChunk;
+        }
+        return &tail_->slots[tail_->used++];
+      }
+
+      void release(Slot &s) {
+        --((s.flags & ONCE) ? onceCount_ : alwaysCount_);
+        if (s.flags & PENDING) {
+          --pendingCount_;
+        }
+        recycle(s);
+      }
+
+      void recycle(Slot &s) {
+        s.callback.reset();
+        if (s.eventId < ListedEvents) {
+          s.flags = ZOMBIE;
+          ++zombieCount_;
+        } else {
+          s.flags = 0;
+          ++freeCount_;
+        }
+      }
+
+      // only called when no dispatch is in progress
+      void settle() {
+        if (pendingCount_ > 0 || removedCount_ > 0) {
+          forEachSlot([this](Slot &s){
+            if (s.flags == REMOVED) {
+              --removedCount_;
+              recycle(s);
+            } else {
+              s.flags &= ~PENDING;
+            }
+          });
+          pendingCount_ = 0;
+        }
+
+        for (std::size_t i = 0; zombieCount_ > 0 && i < ListedEvents; ++i) {
+          auto &list = lists_[i];
+          Slot *prev = nullptr;
+          for (auto s = list.head; s; ) {
+            auto next = s->next;
+            if (s->flags == ZOMBIE) {
+              (prev ? prev->next : list.head) = next;
+              if (list.tail == s) {
+                list.tail = prev;
+              }
+              s->next = nullptr;
+              s->flags = 0;
+              --zombieCount_;
+              ++freeCount_;
+            } else {
+              prev = s;
+            }
+            s = next;
+          }
+        }
+      }
+
+    private:
+      std::array<Slot, InlineSlots> inline_{};
+      std::uint32_t inlineUsed_{0};
+      std::unique_ptr<Chunk> overflow_{nullptr};
+      Chunk *tail_{nullptr};
+      std::array<EventSlots, ListedEvents> lists_{};
+      std::uint32_t alwaysCount_{0};
+      std::uint32_t onceCount_{0};
+      std::uint32_t freeCount_{0};
+      std::uint32_t pendingCount_{0};
+      std::uint32_t zombieCount_{0};
+      std::uint32_t removedCount_{0};
+      std::uint32_t depth_{0};
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_CALLBACK_H_ */
@@ -4,6 +4,17 @@
 #include <cstdlib>
 #include "uv.h"
 
+// define UVCPP_COMPACT_HANDLES for servers holding a large number of
+// mostly idle connections, handles then embed no callback slots and
+// streams allocate their read buffer on the first read.
+// define UVCPP_LOOP_READ_BUFFER to have streams read into the scratch
+// buffer of their loop (UVCPP_LOOP_READ_BUF_SIZE bytes) instead of
+// owning a read buffer, EvRead data is only valid within the callback
+// either way.
+#ifndef UVCPP_STREAM_BUF_SIZE
+#define UVCPP_STREAM_BUF_SIZE 4096
+#endif
+
 namespace uvcpp {
   #define STRINGIFY(s) #s
 
@@ -0,0 +1,419 @@
+#ifndef UVCPP_FRAMING_H_
+#define UVCPP_FRAMING_H_
+#include "stream.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// frames above this size fail with UV_EMSGSIZE
+#ifndef UVCPP_MAX_FRAME_SIZE
+#define UVCPP_MAX_FRAME_SIZE (16 * 1024 * 1024)
+#endif
+
+// reserved up front for a partial frame at most, whatever size its header
+// declares, the rest grows as the bytes arrive
+#ifndef UVCPP_FRAME_RESERVE_SIZE
+#define UVCPP_FRAME_RESERVE_SIZE 65536
+#endif
+
+namespace uvcpp {
+
+  /**
+   * a whole frame, header is the length prefix (nullptr for delimited
+   * records), data the payload without the prefix or the delimiter. both
+   * point into the read buffer of the stream or the reassembly buffer of
+   * the framer, so they are only valid within the callback, like EvRead.
+   */
+  struct EvFrame : public Event {
+    EvFrame(
+      const char *header, std::size_t headerSize,
+      const char *data, std::size_t size) :
+      header(header), headerSize(headerSize), data(data), size(size) { }
+
+    const char *header;
+    std::size_t headerSize;
+    const char *data;
+    std::size_t size;
+  };
+
+  // framers have no libuv counterpart, Resource only needs the data member
+  struct FramerData {
+    void *data;
+  };
+
+  /**
+   * cuts the bytes read from a stream into frames and publishes EvFrame
+   * for each of them. frames that are whole within one read are published
+   * from the read buffer as they are, only a frame that spans reads is
+   * copied into the reassembly buffer. a malformed or oversized frame
+   * publishes EvError and the framer ignores further input until reset().
+   *
+   * Derived provides
+   *   ssize_t frameSize(const char *data, std::size_t len): size of the
+   *     frame that starts at data, 0 if it can not be told from len bytes
+   *   ssize_t resume(const char *pending, std::size_t pendingLen,
+   *     const char *data, std::size_t len): number of bytes of data that
+   *     complete the frame begun in pending, > len if they do not
+   *   std::size_t headerSize(const char *frame, std::size_t size)
+   *   std::size_t trailerSize()
+   * where negative results are errors.
+   */
+  template <typename Derived>
+  class Framer : public Resource<FramerData, Derived> {
+    public:
+      Framer(
+        const std::shared_ptr<Loop> &loop,
+        std::size_t maxFrameSize = UVCPP_MAX_FRAME_SIZE) :
+        Resource<FramerData, Derived>(loop), maxFrameSize_(maxFrameSize) { }
+
+      /**
+       * feeds the reads of the stream to the framer, the framer must
+       * outlive the subscription, stream.off() it to detach
+       */
+      template <typename U, typename D>
+      Subscription attach(Stream<U, D> &stream) {
+        return stream.template on<EvRead>([this](const auto &e, auto &s) {
+          this->feed(e.buf, e.nread);
+        });
+      }
+
+      bool feed(const char *data, std::size_t len) {
+        if (failed_) {
+          return false;
+        }
+        auto self = static_cast<Derived *>(this);
+
+        if (!pending_.empty()) {
+          auto need = self->resume(pending_.data(), pending_.size(), data, len);
+          if (need < 0) {
+            return fail(need);
+          }
+          if (static_cast<std::size_t>(need) > len) {
+            return bufferPending(data, len);
+          }
+          if (pending_.size() + need > maxFrameSize_) {
+            return fail(UV_EMSGSIZE);
+          }
+          pending_.append(data, need);
+          data += need;
+          len -= need;
+          publishFrame(pending_.data(), pending_.size());
+          pending_.clear();
+          if (failed_) {
+            return false;
+          }
+        }
+
+        while (len > 0) {
+          auto size = self->frameSize(data, len);
+          if (size < 0) {
+            return fail(size);
+          }
+          if (size == 0 || static_cast<std::size_t>(size) > len) {
+            pending_.reserve(std::min<std::size_t>(
+                size, UVCPP_FRAME_RESERVE_SIZE));
+            break;
+          }
+          publishFrame(data, size);
+          if (failed_) {
+            return false;
+          }
+          data += size;
+          len -= size;
+        }
+        return bufferPending(data, len);
+      }
+
+      // drops the partial frame and clears a previous error
+      void reset() {
+        pending_.clear();
+        failed_ = false;
+      }
+
+      // bytes of the partial frame held in the reassembly buffer
+      std::size_t getPendingSize() const {
+        return pending_.size();
+      }
+
+      // bytes allocated for the reassembly buffer
+      std::size_t getPendingCapacity() const {
+        return pending_.capacity();
+      }
+
+    protected:
+      std::size_t getMaxFrameSize() const {
+        return maxFrameSize_;
+      }
+
+    private:
+      bool bufferPending(const char *data, std::size_t len) {
+        if (len == 0) {
+          return true;
+        }
+        if (pending_.size() + len > maxFrameSize_) {
+          return fail(UV_EMSGSIZE);
+        }
+        pending_.append(data, len);
+        return true;
+      }
+
+      void publishFrame(const char *frame, std::size_t size) {
+        auto self = static_cast<Derived *>(this);
+        auto headerSize = self->headerSize(frame, size);
+        this->template publish<EvFrame>(EvFrame{
+          headerSize > 0 ? frame : nullptr, headerSize,
+          frame + headerSize, size - headerSize - self->trailerSize() });
+      }
+
+      bool fail(int status) {
+        failed_ = true;
+        pending_.clear();
+        this->reportError("framing", status);
+        return false;
+      }
+
+    private:
+      std::string pending_;
+      std::size_t maxFrameSize_;
+      bool failed_{false};
+  };
+
+  enum class ByteOrder {
+    BIG,
+    LITTLE
+  };
+
+  /**
+   * frames with a fixed size header that holds the length of the payload
+   * in lengthSize (1 to 8) bytes from lengthOffset on, the header is
+   * lengthOffset + lengthSize bytes unless headerSize says otherwise
+   */
+  class LengthPrefixFramer : public Framer<LengthPrefixFramer> {
+    static constexpr std::size_t kMaxHeaderSize = 64;
+
+    public:
+      LengthPrefixFramer(
+        const std::shared_ptr<Loop> &loop,
+        std::size_t lengthSize = 4, ByteOrder order = ByteOrder::BIG,
+        std::size_t lengthOffset = 0, std::size_t headerSize = 0,
+        std::size_t maxFrameSize = UVCPP_MAX_FRAME_SIZE) :
+        Framer(loop, maxFrameSize), lengthSize_(lengthSize), order_(order),
+        lengthOffset_(lengthOffset),
+        headerSize_(headerSize > 0 ? headerSize : lengthOffset + lengthSize) {
+        assert(lengthSize_ >= 1 && lengthSize_ <= 8);
+        assert(lengthOffset_ + lengthSize_ <= headerSize_);
+        assert(headerSize_ <= kMaxHeaderSize);
+      }
+
+      ssize_t frameSize(const char *data, std::size_t len) {
+        if (len < headerSize_) {
+          return 0;
+        }
+        std::uint64_t length = 0;
+        auto field = reinterpret_cast<const unsigned char *>(
+          data + lengthOffset_);
+        if (order_ == ByteOrder::BIG) {
+          for (std::size_t i = 0; i < lengthSize_; ++i) {
+            length = (length << 8) | field[i];
+          }
+        } else {
+          for (std::size_t i = lengthSize_; i > 0; --i) {
+            length = (length << 8) | field[i - 1];
+          }
+        }
+        // a limit below the header size admits no frame at all
+        if (getMaxFrameSize() < headerSize_ ||
+            length > getMaxFrameSize() - headerSize_) {
+          return UV_EMSGSIZE;
+        }
+        return headerSize_ + length;
+      }
+
+      ssize_t resume(
+        const char *pending, std::size_t pendingLen,
+        const char *data, std::size_t len) {
+        ssize_t size;
+        if (pendingLen >= headerSize_) {
+          size = frameSize(pending, pendingLen);
+        } else {
+          // the header itself spans the reads
+          char header[kMaxHeaderSize];
+          auto fromData = headerSize_ - pendingLen;
+          if (fromData > len) {
+            return len + 1;
+          }
+          std::memcpy(header, pending, pendingLen);
+          std::memcpy(header + pendingLen, data, fromData);
+          size = frameSize(header, headerSize_);
+        }
+        return size < 0 ? size : size - pendingLen;
+      }
+
+      std::size_t headerSize(const char *frame, std::size_t size) const {
+        return headerSize_;
+      }
+
+      std::size_t trailerSize() const {
+        return 0;
+      }
+
+    private:
+      std::size_t lengthSize_;
+      ByteOrder order_;
+      std::size_t lengthOffset_;
+      std::size_t headerSize_;
+  };
+
+  /**
+   * frames prefixed with the length of the payload as an unsigned LEB128
+   * varint, the encoding of protobuf
+   */
+  class VarintFramer : public Framer<VarintFramer> {
+    static constexpr std::size_t kMaxVarintSize = 10;
+
+    public:
+      VarintFramer(
+        const std::shared_ptr<Loop> &loop,
+        std::size_t maxFrameSize = UVCPP_MAX_FRAME_SIZE) :
+        Framer(loop, maxFrameSize) { }
+
+      ssize_t frameSize(const char *data, std::size_t len) {
+        std::uint64_t length = 0;
+        auto bytes = reinterpret_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < len; ++i) {
+          if (i == kMaxVarintSize) {
+            return UV_EPROTO;
+          }
+          // only the lowest bit of the 10th byte fits in 64 bits
+          if (i == kMaxVarintSize - 1 && bytes[i] > 1) {
+            return UV_EPROTO;
+          }
+          length |= static_cast<std::uint64_t>(bytes[i] & 0x7f) << (7 * i);
+          if (!(bytes[i] & 0x80)) {
+            if (getMaxFrameSize() < i + 1 ||
+                length > getMaxFrameSize() - (i + 1)) {
+              return UV_EMSGSIZE;
+            }
+            return i + 1 + length;
+          }
+        }
+        return len >= kMaxVarintSize ? UV_EPROTO : 0;
+      }
+
+      ssize_t resume(
+        const char *pending, std::size_t pendingLen,
+        const char *data, std::size_t len) {
+        ssize_t size;
+        if (pendingLen >= kMaxVarintSize || hasVarint(pending, pendingLen)) {
+          size = frameSize(pending, pendingLen);
+        } else {
+          // the varint itself spans the reads
+          char prefix[kMaxVarintSize];
+          auto fromData = std::min(kMaxVarintSize - pendingLen, len);
+          std::memcpy(prefix, pending, pendingLen);
+          std::memcpy(prefix + pendingLen, data, fromData);
+          size = frameSize(prefix, pendingLen + fromData);
+          if (size == 0) {
+            return len + 1;
+          }
+        }
+        return size < 0 ? size : size - pendingLen;
+      }
+
+      std::size_t headerSize(const char *frame, std::size_t size) const {
+        std::size_t i = 0;
+        while (frame[i] & 0x80) {
+          ++i;
+        }
+        return i + 1;
+      }
+
+      std::size_t trailerSize() const {
+        return 0;
+      }
+
+    private:
+      static bool hasVarint(const char *data, std::size_t len) {
+        for (std::size_t i = 0; i < len; ++i) {
+          if (!(data[i] & 0x80)) {
+            return true;
+          }
+        }
+        return false;
+      }
+  };
+
+  /**
+   * records terminated by a delimiter of one or more bytes, e.g. "\n" or
+   * "\r\n", which is not part of EvFrame::data. the scan is memchr() for
+   * the first byte of the delimiter, which libc vectorizes.
+   */
+  class DelimiterFramer : public Framer<DelimiterFramer> {
+    public:
+      DelimiterFramer(
+        const std::shared_ptr<Loop> &loop,
+        const std::string &delimiter = "\n",
+        std::size_t maxFrameSize = UVCPP_MAX_FRAME_SIZE) :
+        Framer(loop, maxFrameSize), delimiter_(delimiter) {
+        assert(!delimiter_.empty());
+      }
+
+      ssize_t frameSize(const char *data, std::size_t len) {
+        auto end = find(data, len);
+        return end > getMaxFrameSize() ? UV_EMSGSIZE : end;
+      }
+
+      ssize_t resume(
+        const char *pending, std::size_t pendingLen,
+        const char *data, std::size_t len) {
+        // a delimiter split by the reads
+        auto dlen = delimiter_.size();
+        for (std::size_t i = dlen - 1; i > 0; --i) {
+          if (i <= pendingLen && dlen - i <= len &&
+              std::memcmp(
+                pending + pendingLen - i, delimiter_.data(), i) == 0 &&
+              std::memcmp(data, delimiter_.data() + i, dlen - i) == 0) {
+            return dlen - i;
+          }
+        }
+        auto end = find(data, len);
+        return end > 0 ? end : len + 1;
+      }
+
+      std::size_t headerSize(const char *frame, std::size_t size) const {
+        return 0;
+      }
+
+      std::size_t trailerSize() const {
+        return delimiter_.size();
+      }
+
+    private:
+      // size up to and including the first delimiter, 0 if there is none
+      std::size_t find(const char *data, std::size_t len) const {
+        auto dlen = delimiter_.size();
+        auto first = delimiter_[0];
+        auto p = data;
+        auto end = data + len;
+        while (static_cast<std::size_t>(end - p) >= dlen) {
+          p = static_cast<const char *>(
+            std::memchr(p, first, end - p - dlen + 1));
+          if (!p) {
+            return 0;
+          }
+          if (dlen == 1 ||
+              std::memcmp(p + 1, delimiter_.data() + 1, dlen - 1) == 0) {
+            return p - data + dlen;
+          }
+          ++p;
+        }
+        return 0;
+      }
+
+    private:
+      std::string delimiter_;
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_FRAMING_H_ */
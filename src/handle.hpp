@@ -28,20 +28,18 @@ namespace uvcpp {
       }
 
       virtual bool init() {
-        this->template once<EvError>([this](const auto &e, auto &handle){
-          this->close();
-        });
+        closeOnError_ = true;
         return true;
       }
 
-      template<typename E>
-      void on(EventCallback<E, Derived> &&callback) {
+      template<typename E, typename F>
+      Subscription on(F &&callback) {
         if (std::is_same<E, EvClose>::value) {
-          Resource<T, Derived>::template once<E>(
-            std::forward<EventCallback<E, Derived>>(callback));
+          return Resource<T, Derived>::template
+            once<E>(std::forward<F>(callback));
         } else {
-          Resource<T, Derived>::template on<E>(
-            std::forward<EventCallback<E, Derived>>(callback));
+          return Resource<T, Derived>::template
+            on<E>(std::forward<F>(callback));
         }
       }
 
@@ -59,11 +57,29 @@ namespace uvcpp {
         return handle->init() ? handle : nullptr;
       }
 
+    protected:
+      // handles initialized through Handle::init() are closed before
+      // the EvError callbacks are called
+      void reportError(const char *funName, int err) {
+        if (closeOnError_) {
+          closeOnError_ = false;
+          close();
+        }
+        Resource<T, Derived>::reportError(funName, err);
+      }
+
+      // called right before EvClose is published
+      virtual void onClose() { }
+
     private:
       static void closeCallback(uv_handle_t *h) {
-        reinterpret_cast<Handle *>(h->data)->template
-          publish<EvClose>(EvClose{});
+        auto handle = reinterpret_cast<Handle *>(h->data);
+        handle->onClose();
+        handle->template publish<EvClose>(EvClose{});
       }
+
+    private:
+      bool closeOnError_{false};
   };
 
 } /* end of namspace: uvcpp */
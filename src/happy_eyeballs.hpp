@@ -0,0 +1,292 @@
+#ifndef UVCPP_HAPPY_EYEBALLS_H_
+#define UVCPP_HAPPY_EYEBALLS_H_
+#include "tcp.hpp"
+#include "timer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <unistd.h>
+
+namespace uvcpp {
+
+  /**
+   * connects a Tcp to a host name the way RFC 8305 describes it: the name
+   * is resolved, the addresses are interleaved by family starting with
+   * IPv6, and an attempt is started for each of them attemptDelay apart,
+   * or right away once the previous one fails. the first attempt that
+   * connects wins, its socket is moved into tcp, which then publishes
+   * EvConnect as if it had connected by itself, the other attempts are
+   * closed. an attempt gives up after attemptTimeout.
+   *
+   * tcp must be created with Domain::UNSPEC and not be connected yet. if
+   * the name does not resolve or every attempt fails, tcp publishes
+   * EvError with the last error and is closed, like after
+   * Tcp::connect(). closing tcp cancels the connect.
+   */
+  class HappyEyeballs : public std::enable_shared_from_this<HappyEyeballs> {
+    struct Attempt {
+      std::weak_ptr<Tcp> tcp;
+      std::weak_ptr<Timer> timer;
+      bool finished{false};
+    };
+
+    public:
+      // in milliseconds, the defaults are the ones RFC 8305 recommends
+      static bool connect(
+        Tcp &tcp, const std::string &host, uint16_t port,
+        uint64_t attemptDelay = 250, uint64_t attemptTimeout = 10000) {
+        uv_os_fd_t fd;
+        if (uv_fileno(
+              reinterpret_cast<uv_handle_t *>(tcp.get()), &fd) != UV_EBADF) {
+          LOG_E("happy eyeballs needs a Tcp without a socket");
+          return false;
+        }
+        auto dns = DNSRequest::createShared(tcp.getLoop());
+        auto he = std::make_shared<HappyEyeballs>(
+          tcp, port, attemptDelay, attemptTimeout);
+        he->dns_ = dns;
+
+        dns->on<EvDNSResult>([he](const auto &e, auto &r) {
+          he->onResolved(e.dnsResults);
+        });
+        dns->on<EvError>([he](const auto &e, auto &r) {
+          he->fail(e.status);
+        });
+        dns->sharedRefUntil<EvDNSRequestFinish>();
+
+        he->closeSub_ = tcp.on<EvClose>([he](const auto &e, auto &t) {
+          he->cancel();
+        });
+        he->destroySub_ = tcp.on<EvDestroy>([he](const auto &e, auto &t) {
+          he->target_ = nullptr;
+          he->cancel();
+        });
+
+        // the connect timeout of tcp covers the resolution and the race
+        tcp.startConnectTimeout();
+        dns->resolve(host);
+        return true;
+      }
+
+      HappyEyeballs(
+        Tcp &tcp, uint16_t port,
+        uint64_t attemptDelay, uint64_t attemptTimeout) :
+        target_(&tcp), port_(port),
+        // RFC 8305 asks for at least 100ms and at most 2s
+        attemptDelay_(std::min<uint64_t>(
+            std::max<uint64_t>(attemptDelay, 100), 2000)),
+        attemptTimeout_(attemptTimeout > 0 ? attemptTimeout : 1) { }
+
+    private:
+      void onResolved(const EvDNSResult::DNSResultVector &ips) {
+        if (done_) {
+          return;
+        }
+        std::vector<SockAddrStorage> v6;
+        std::vector<SockAddrStorage> v4;
+        for (auto &ip : ips) {
+          SockAddrStorage sas;
+          if (NetUtil::convertIPAddress(ip, port_, &sas)) {
+            (sas.ss_family == AF_INET6 ? v6 : v4).push_back(sas);
+          }
+        }
+        for (std::size_t i = 0; i < v6.size() || i < v4.size(); ++i) {
+          if (i < v6.size()) {
+            addrs_.push_back(v6[i]);
+          }
+          if (i < v4.size()) {
+            addrs_.push_back(v4[i]);
+          }
+        }
+        if (addrs_.empty()) {
+          fail(UV_EAI_NONAME);
+          return;
+        }
+
+        auto self = shared_from_this();
+        auto timer = Timer::createShared(target_->getLoop());
+        if (timer) {
+          timer->sharedRefUntil<EvClose>();
+          timer->on<EvTimer>([self](const auto &e, auto &t) {
+            self->startNext();
+          });
+          delayTimer_ = timer;
+        }
+        startNext();
+      }
+
+      void startNext() {
+        while (!done_ && next_ < addrs_.size()) {
+          auto sa = reinterpret_cast<SockAddr *>(&addrs_[next_++]);
+          if (startAttempt(sa)) {
+            break;
+          }
+          lastError_ = UV_ECONNREFUSED;
+        }
+        if (done_) {
+          return;
+        }
+        if (active_ == 0 && next_ == addrs_.size()) {
+          fail(lastError_);
+          return;
+        }
+        auto timer = delayTimer_.lock();
+        if (timer && next_ < addrs_.size()) {
+          timer->start(attemptDelay_, 0);
+        }
+      }
+
+      bool startAttempt(SockAddr *sa) {
+        auto loop = target_->getLoop();
+        auto tcp = Tcp::createShared(loop);
+        auto timer = Timer::createShared(loop);
+        if (!tcp || !timer) {
+          if (tcp) {
+            tcp->close();
+          }
+          if (timer) {
+            timer->close();
+          }
+          return false;
+        }
+        tcp->sharedRefUntil<EvClose>();
+        timer->sharedRefUntil<EvClose>();
+
+        auto self = shared_from_this();
+        auto attempt = std::make_shared<Attempt>();
+        attempt->tcp = tcp;
+        attempt->timer = timer;
+        tcp->on<EvConnect>([self, attempt](const auto &e, auto &t) {
+          self->onAttemptConnected(*attempt, t);
+        });
+        // errors close the attempt
+        tcp->on<EvError>([self, attempt](const auto &e, auto &t) {
+          self->onAttemptFailed(*attempt, e.status);
+        });
+        timer->on<EvTimer>([self, attempt](const auto &e, auto &t) {
+          self->onAttemptFailed(*attempt, UV_ETIMEDOUT);
+        });
+
+        if (!tcp->connect(sa)) {
+          tcp->close();
+          timer->close();
+          return false;
+        }
+        timer->start(attemptTimeout_, 0);
+        attempts_.push_back(std::move(attempt));
+        ++active_;
+        return true;
+      }
+
+      void onAttemptFailed(Attempt &attempt, int status) {
+        if (attempt.finished) {
+          return;
+        }
+        closeAttempt(attempt);
+        --active_;
+        lastError_ = status;
+        if (!done_) {
+          startNext();
+        }
+      }
+
+      void onAttemptConnected(Attempt &attempt, Tcp &winner) {
+        if (done_ || attempt.finished) {
+          return;
+        }
+        // the socket outlives the attempt as a duplicate held by target_
+        uv_os_fd_t fd;
+        int err = uv_fileno(
+          reinterpret_cast<uv_handle_t *>(winner.get()), &fd);
+        auto dupFd = err == 0 ? ::dup(fd) : -1;
+        if (dupFd < 0) {
+          onAttemptFailed(attempt, err < 0 ? err : -errno);
+          return;
+        }
+
+        auto target = target_;
+        done_ = true;
+        finish();
+        target->stopConnectTimeout();
+        if ((err = uv_tcp_open(target->get(), dupFd)) != 0) {
+          ::close(dupFd);
+          target->reportError("uv_tcp_open", err);
+          return;
+        }
+        auto sa = winner.getSockAddr();
+        memcpy(&target->sas_, sa, sa->sa_family == AF_INET ?
+               sizeof(SockAddr4) : sizeof(SockAddr6));
+        target->publish<EvConnect>(EvConnect{});
+      }
+
+      void fail(int status) {
+        if (done_) {
+          return;
+        }
+        done_ = true;
+        finish();
+        if (target_) {
+          LOG_E("failed to connect: %s", uv_strerror(status));
+          target_->stopConnectTimeout();
+          target_->reportError("connect", status);
+        }
+      }
+
+      void cancel() {
+        if (done_) {
+          return;
+        }
+        done_ = true;
+        if (auto dns = dns_.lock()) {
+          dns->cancel();
+        }
+        finish();
+      }
+
+      void closeAttempt(Attempt &attempt) {
+        attempt.finished = true;
+        if (auto tcp = attempt.tcp.lock()) {
+          tcp->close();
+        }
+        if (auto timer = attempt.timer.lock()) {
+          timer->close();
+        }
+      }
+
+      // closes what is left of the race, the object goes away with it
+      void finish() {
+        if (auto timer = delayTimer_.lock()) {
+          timer->close();
+        }
+        for (auto &a : attempts_) {
+          if (!a->finished) {
+            closeAttempt(*a);
+          }
+        }
+        attempts_.clear();
+        if (target_) {
+          target_->off(closeSub_);
+          target_->off(destroySub_);
+        }
+      }
+
+    private:
+      Tcp *target_;
+      uint16_t port_;
+      uint64_t attemptDelay_;
+      uint64_t attemptTimeout_;
+      std::weak_ptr<DNSRequest> dns_;
+      std::weak_ptr<Timer> delayTimer_;
+      Subscription closeSub_;
+      Subscription destroySub_;
+      std::vector<SockAddrStorage> addrs_;
+      std::vector<std::shared_ptr<Attempt>> attempts_;
+      std::size_t next_{0};
+      std::size_t active_{0};
+      int lastError_{UV_ECONNREFUSED};
+      bool done_{false};
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_HAPPY_EYEBALLS_H_ */
@@ -1,19 +1,87 @@
 #ifndef UVCPP_LOOP_H_
 #define UVCPP_LOOP_H_
 #include "uv.h"
+#include <algorithm>
+#include <atomic>
 #include <memory> 
 #include <functional>
+#include <vector>
+
+#ifndef UVCPP_LOOP_READ_BUF_SIZE
+#define UVCPP_LOOP_READ_BUF_SIZE 65536
+#endif
 
 namespace uvcpp {
 
+  class ReadBufferPolicy;
+
+  /**
+   * work deferred to the end of the current loop iteration, see
+   * Loop::runBeforePoll(), meant to be embedded in the object it works on
+   */
+  struct PrePollTask {
+    explicit PrePollTask(void (*run)(PrePollTask *task)) : run(run) { }
+
+    void (*run)(PrePollTask *task);
+    PrePollTask *prev{nullptr};
+    PrePollTask *next{nullptr};
+    bool queued{false};
+  };
+
+  /**
+   * base of the per-loop objects of the higher layers, see
+   * Loop::getContext()
+   */
+  class LoopContext {
+    public:
+      virtual ~LoopContext() { }
+
+      /**
+       * called before the loop is destroyed, the context closes its
+       * handles with Loop::closeHandle() here, they have to stay valid
+       * until the context is destroyed
+       */
+      virtual void closeHandles() { }
+  };
+
   class Loop final {
     public:
       virtual ~Loop() {
+        // contexts are destroyed only after their handles are closed
+        for (auto it = contexts_.rbegin(); it != contexts_.rend(); ++it) {
+          if (*it) {
+            (*it)->closeHandles();
+          }
+        }
+        if (prepareInitialized_) {
+          closeHandle(reinterpret_cast<uv_handle_t *>(&prepare_));
+        }
+        // the closes above are finished only if no handle of the user is
+        // left, whose callbacks may run on objects that are gone already
+        if (!ownHandles_.empty() && hasForeignHandles()) {
+          // libuv still refers to the handles of the contexts
+          for (auto &context : contexts_) {
+            context.release();
+          }
+        } else if (!ownHandles_.empty()) {
+          uv_run(&loop_, UV_RUN_NOWAIT);
+        }
+        while (!contexts_.empty()) {
+          contexts_.pop_back();
+        }
         uv_loop_close(&loop_);
       }
 
       bool init() {
-        return uv_loop_init(&loop_) == 0;
+        if (uv_loop_init(&loop_) != 0) {
+          return false;
+        }
+        loop_.data = this;
+        return true;
+      }
+
+      static Loop *fromRaw(uv_loop_t *loop) {
+        return reinterpret_cast<Loop *>(loop->data);
       }
 
       uv_loop_t *getRaw() {
@@ -27,9 +95,171 @@ namespace uvcpp {
       void stop() {
         uv_stop(&loop_);
       }
+
+      /**
+       * scratch buffer for handles that consume their data within the read
+       * callback, only one read callback runs at a time on a loop, so all
+       * of them can share it. allocated on first use.
+       */
+      char *getReadBuffer() {
+        if (!readBuf_) {
+          readBuf_.reset(new char[UVCPP_LOOP_READ_BUF_SIZE]);
+        }
+        return readBuf_.get();
+      }
+
+      std::size_t getReadBufferSize() const {
+        return UVCPP_LOOP_READ_BUF_SIZE;
+      }
+
+      /**
+       * read buffer policy for the handles of this loop that have none
+       * of their own, see read_buffer.hpp
+       */
+      void setReadBufferPolicy(std::shared_ptr<ReadBufferPolicy> policy) {
+        readBufferPolicy_ = std::move(policy);
+      }
+
+      ReadBufferPolicy *getReadBufferPolicy() const {
+        return readBufferPolicy_.get();
+      }
+
+      /**
+       * runs the task once, right before the loop polls for I/O again, all
+       * the tasks queued during an iteration share one uv_prepare_t that is
+       * only active while tasks are queued. queuing a queued task is a no-op.
+       */
+      bool runBeforePoll(PrePollTask *task) {
+        if (task->queued) {
+          return true;
+        }
+        if (!prepareInitialized_) {
+          if (uv_prepare_init(&loop_, &prepare_) != 0) {
+            return false;
+          }
+          prepare_.data = this;
+          prepareInitialized_ = true;
+        }
+        if (!taskHead_ && uv_prepare_start(&prepare_, onPrepareCallback) != 0) {
+          return false;
+        }
+
+        task->queued = true;
+        task->prev = taskTail_;
+        task->next = nullptr;
+        if (taskTail_) {
+          taskTail_->next = task;
+        } else {
+          taskHead_ = task;
+        }
+        taskTail_ = task;
+        return true;
+      }
+
+      void cancelBeforePoll(PrePollTask *task) {
+        if (!task->queued) {
+          return;
+        }
+        unlink(task);
+        if (!taskHead_) {
+          uv_prepare_stop(&prepare_);
+        }
+      }
+
+      /**
+       * closes a handle that belongs to the loop or one of its contexts
+       * rather than to the user, the close is finished when the loop is
+       * destroyed. a handle that is closing already keeps its callback.
+       */
+      void closeHandle(uv_handle_t *handle) {
+        if (!uv_is_closing(handle)) {
+          uv_close(handle, nullptr);
+        }
+        ownHandles_.push_back(handle);
+      }
     
+      /**
+       * per-loop singleton of type C, which derives LoopContext and is
+       * constructible from Loop &, created on first use and destroyed
+       * before the loop is closed
+       */
+      template <typename C>
+      C &getContext() {
+        auto index = getContextIndex<C>();
+        if (index >= contexts_.size()) {
+          contexts_.resize(index + 1);
+        }
+        auto &context = contexts_[index];
+        if (!context) {
+          context.reset(new C(*this));
+        }
+        return static_cast<C &>(*context);
+      }
+
+    private:
+      // loops may run on threads of their own
+      static std::size_t countContextIndex() {
+        static std::atomic<std::size_t> index{0};
+        return index++;
+      }
+
+      template <typename C>
+      static std::size_t getContextIndex() {
+        static std::size_t index = countContextIndex();
+        return index;
+      }
+
+      // handles of the user may be freed already, they are only compared
+      bool hasForeignHandles() {
+        struct Walk {
+          std::vector<uv_handle_t *> *own;
+          bool found;
+        } walk{&ownHandles_, false};
+        uv_walk(&loop_, [](uv_handle_t *handle, void *arg) {
+          auto w = reinterpret_cast<Walk *>(arg);
+          if (std::find(w->own->begin(), w->own->end(), handle) ==
+              w->own->end()) {
+            w->found = true;
+          }
+        }, &walk);
+        return walk.found;
+      }
+
+      void unlink(PrePollTask *task) {
+        if (task->prev) {
+          task->prev->next = task->next;
+        } else {
+          taskHead_ = task->next;
+        }
+        if (task->next) {
+          task->next->prev = task->prev;
+        } else {
+          taskTail_ = task->prev;
+        }
+        task->prev = task->next = nullptr;
+        task->queued = false;
+      }
+
+      // tasks queued while running are run in the same pass
+      static void onPrepareCallback(uv_prepare_t *prepare) {
+        auto loop = reinterpret_cast<Loop *>(prepare->data);
+        while (auto task = loop->taskHead_) {
+          loop->unlink(task);
+          task->run(task);
+        }
+        uv_prepare_stop(prepare);
+      }
+
     protected:
       uv_loop_t loop_;
+      std::unique_ptr<char[]> readBuf_{nullptr};
+      std::shared_ptr<ReadBufferPolicy> readBufferPolicy_{nullptr};
+      uv_prepare_t prepare_;
+      bool prepareInitialized_{false};
+      PrePollTask *taskHead_{nullptr};
+      PrePollTask *taskTail_{nullptr};
+      std::vector<std::unique_ptr<LoopContext>> contexts_;
+      std::vector<uv_handle_t *> ownHandles_;
   };
 } /* end of namspace: uvcpp */
 
@@ -4,6 +4,14 @@
 #include <cassert>
 
 namespace uvcpp {
+  class Pipe;
+
+  template <>
+  struct EventTraits<Pipe> {
+    using Events = EventList<
+      EvRead, EvReadOwned, EvWrite, EvBufferRecycled, EvConnect,
+      EvShutdown, EvAccept<Pipe>, EvAccept<Tcp>, EvClose, EvError, EvDestroy>;
+  };
 
   class Pipe : public Stream<uv_pipe_t, Pipe> {
     public:
@@ -19,6 +27,11 @@ namespace uvcpp {
           return false;
         }
 
+        // only ipc pipes can receive handles
+        if (!crossProcess_) {
+          return true;
+        }
+
         // stream handles can be sent over pipe between different processes
         // or threads, stream handles can be sent with uv_write2, in the
         // receiving end of the pipe, we can listen for EvRead events, and
@@ -100,6 +113,7 @@ namespace uvcpp {
           connectReq_ = ConnectReq::createUnique(this->getLoop());
         }
         uv_pipe_connect(connectReq_->get(), get(), name.c_str(), onConnect);
+        startConnectTimeout();
       }
 
       bool sendTcpHandle(Tcp &tcp) {
@@ -145,6 +159,7 @@ namespace uvcpp {
     private:
       static void onConnect(uv_connect_t *req, int status) {
         auto pipe = reinterpret_cast<Pipe *>(req->handle->data);
+        pipe->stopConnectTimeout();
         if (status < 0) {
           LOG_E("onConnect failed: %s", uv_strerror(status));
           pipe->reportError("uv_pipe_connect", status);
@@ -0,0 +1,288 @@
+#ifndef UVCPP_READ_BUFFER_H_
+#define UVCPP_READ_BUFFER_H_
+#include <cstddef>
+#include <array>
+#include <memory>
+#include <vector>
+#include "uv.h"
+#include "defs.h"
+#include "loop.hpp"
+#include "util/buffer.hpp"
+
+namespace uvcpp {
+
+  /**
+   * decides where the data of the next read of a handle goes, installed
+   * per handle with setReadBufferPolicy() of Stream/Udp, or per loop with
+   * Loop::setReadBufferPolicy() for handles that have none. a policy shared
+   * by several handles must not keep per-handle state.
+   */
+  class ReadBufferPolicy {
+    public:
+      virtual ~ReadBufferPolicy() { }
+
+      /**
+       * called from the alloc callback of libuv, fills buf with the buffer
+       * the next read goes to, suggestedSize is what libuv suggests
+       */
+      virtual void allocate(
+        uv_handle_t *handle, std::size_t suggestedSize, uv_buf_t *buf) = 0;
+
+      /**
+       * called after the read is published, nread is the result of the
+       * read (0 for EAGAIN, < 0 for errors), the data is not used anymore
+       */
+      virtual void release(
+        uv_handle_t *handle, const uv_buf_t *buf, ssize_t nread) = 0;
+  };
+
+  /**
+   * power of two size classes from 1 KiB to 1 MiB, released buffers are
+   * kept on a free list per class (linked through the buffers themselves)
+   * for reuse, larger buffers are not pooled. not thread safe, use one
+   * pool per loop.
+   */
+  class ReadBufferPool {
+    static constexpr std::size_t kMinClassShift = 10;
+    static constexpr std::size_t kMaxClassShift = 20;
+    static constexpr std::size_t kClassCount =
+      kMaxClassShift - kMinClassShift + 1;
+
+    struct FreeBuffer {
+      FreeBuffer *next;
+    };
+
+    struct FreeList {
+      FreeBuffer *head{nullptr};
+      std::size_t count{0};
+    };
+
+    public:
+      explicit ReadBufferPool(std::size_t maxFreePerClass = 64) :
+        maxFreePerClass_(maxFreePerClass) { }
+      ReadBufferPool(const ReadBufferPool &) = delete;
+      ReadBufferPool &operator=(const ReadBufferPool &) = delete;
+
+      ~ReadBufferPool() {
+        for (auto &list : freeLists_) {
+          while (list.head) {
+            auto buf = list.head;
+            list.head = buf->next;
+            delete [] reinterpret_cast<char *>(buf);
+          }
+        }
+      }
+
+      /**
+       * returns a buffer of at least size bytes, size is updated to the
+       * real size of the buffer, which must be passed back to give()
+       */
+      char *take(std::size_t &size) {
+        auto index = classIndex(size);
+        if (index >= kClassCount) {
+          return new char[size];
+        }
+
+        size = classSize(index);
+        auto &list = freeLists_[index];
+        if (list.head) {
+          auto buf = list.head;
+          list.head = buf->next;
+          --list.count;
+          return reinterpret_cast<char *>(buf);
+        }
+        return new char[size];
+      }
+
+      void give(char *buf, std::size_t size) {
+        auto index = classIndex(size);
+        if (index >= kClassCount || classSize(index) != size ||
+            freeLists_[index].count >= maxFreePerClass_) {
+          delete [] buf;
+          return;
+        }
+
+        auto &list = freeLists_[index];
+        auto freeBuf = reinterpret_cast<FreeBuffer *>(buf);
+        freeBuf->next = list.head;
+        list.head = freeBuf;
+        ++list.count;
+      }
+
+    private:
+      static std::size_t classSize(std::size_t index) {
+        return std::size_t{1} << (index + kMinClassShift);
+      }
+
+      static std::size_t classIndex(std::size_t size) {
+        std::size_t index = 0;
+        while (index < kClassCount && classSize(index) < size) {
+          ++index;
+        }
+        return index;
+      }
+
+    private:
+      std::array<FreeList, kClassCount> freeLists_{};
+      std::size_t maxFreePerClass_;
+  };
+
+  /**
+   * reads go to the scratch buffer of the loop, for handles that consume
+   * their data within the read callback, can be shared by all handles
+   */
+  class LoopReadBufferPolicy : public ReadBufferPolicy {
+    public:
+      virtual void allocate(
+        uv_handle_t *handle, std::size_t suggestedSize,
+        uv_buf_t *buf) override {
+        auto loop = Loop::fromRaw(handle->loop);
+        buf->base = loop->getReadBuffer();
+        buf->len = loop->getReadBufferSize();
+      }
+
+      virtual void release(
+        uv_handle_t *handle, const uv_buf_t *buf, ssize_t nread) override { }
+  };
+
+  /**
+   * every read borrows a buffer of a fixed size from the pool, or of the
+   * size libuv suggests if size is 0, can be shared by all handles of the
+   * loop the pool belongs to
+   */
+  class PooledReadBufferPolicy : public ReadBufferPolicy {
+    public:
+      PooledReadBufferPolicy(
+        std::shared_ptr<ReadBufferPool> pool, std::size_t size = 0) :
+        pool_(std::move(pool)), size_(size) { }
+
+      virtual void allocate(
+        uv_handle_t *handle, std::size_t suggestedSize,
+        uv_buf_t *buf) override {
+        std::size_t size = size_ > 0 ? size_ : suggestedSize;
+        buf->base = pool_->take(size);
+        buf->len = size;
+      }
+
+      virtual void release(
+        uv_handle_t *handle, const uv_buf_t *buf, ssize_t nread) override {
+        if (buf->base) {
+          pool_->give(buf->base, buf->len);
+        }
+      }
+
+    private:
+      std::shared_ptr<ReadBufferPool> pool_;
+      std::size_t size_;
+  };
+
+  /**
+   * per-handle policy that borrows buffers from the pool, the size doubles
+   * when a read fills the buffer and halves after a run of reads that use
+   * no more than a quarter of it, an idle handle holds no buffer at all
+   */
+  class AdaptiveReadBufferPolicy : public ReadBufferPolicy {
+    static constexpr int kShrinkAfterSmallReads = 4;
+
+    public:
+      AdaptiveReadBufferPolicy(
+        std::shared_ptr<ReadBufferPool> pool,
+        std::size_t minSize = 1024, std::size_t maxSize = 65536) :
+        pool_(std::move(pool)), minSize_(minSize), maxSize_(maxSize),
+        size_(minSize) { }
+
+      virtual void allocate(
+        uv_handle_t *handle, std::size_t suggestedSize,
+        uv_buf_t *buf) override {
+        std::size_t size = size_;
+        buf->base = pool_->take(size);
+        buf->len = size;
+      }
+
+      virtual void release(
+        uv_handle_t *handle, const uv_buf_t *buf, ssize_t nread) override {
+        if (!buf->base) {
+          return;
+        }
+        pool_->give(buf->base, buf->len);
+
+        if (nread <= 0) {
+          return;
+        }
+
+        if (static_cast<std::size_t>(nread) == buf->len) {
+          smallReads_ = 0;
+          if (size_ < maxSize_) {
+            size_ = size_ * 2 < maxSize_ ? size_ * 2 : maxSize_;
+          }
+        } else if (static_cast<std::size_t>(nread) <= buf->len / 4) {
+          if (++smallReads_ >= kShrinkAfterSmallReads) {
+            smallReads_ = 0;
+            size_ = size_ / 2 > minSize_ ? size_ / 2 : minSize_;
+          }
+        } else {
+          smallReads_ = 0;
+        }
+      }
+
+      std::size_t getBufferSize() const {
+        return size_;
+      }
+
+    private:
+      std::shared_ptr<ReadBufferPool> pool_;
+      std::size_t minSize_;
+      std::size_t maxSize_;
+      std::size_t size_;
+      int smallReads_{0};
+  };
+
+  /**
+   * pool of nul::Buffer of the same capacity for the owned read mode of
+   * Stream, buffers handed out with EvReadOwned can be recycled here when
+   * the consumer is done with them, e.g. from EvBufferRecycled after they
+   * are written. not thread safe, use one pool per loop.
+   */
+  class BufferPool {
+    public:
+      explicit BufferPool(
+        std::size_t bufferSize = UVCPP_STREAM_BUF_SIZE,
+        std::size_t maxFree = 64) :
+        bufferSize_(bufferSize), maxFree_(maxFree) { }
+
+      std::unique_ptr<nul::Buffer> take() {
+        if (free_.empty()) {
+          return std::make_unique<nul::Buffer>(bufferSize_);
+        }
+        auto buffer = std::move(free_.back());
+        free_.pop_back();
+        return buffer;
+      }
+
+      // buffers smaller than the pool's buffer size are dropped
+      void recycle(std::unique_ptr<nul::Buffer> buffer) {
+        if (!buffer || buffer->getCapacity() < bufferSize_ ||
+            free_.size() >= maxFree_) {
+          return;
+        }
+        buffer->setLength(0);
+        free_.push_back(std::move(buffer));
+      }
+
+      std::size_t getBufferSize() const {
+        return bufferSize_;
+      }
+
+      std::size_t getFreeCount() const {
+        return free_.size();
+      }
+
+    private:
+      std::vector<std::unique_ptr<nul::Buffer>> free_;
+      std::size_t bufferSize_;
+      std::size_t maxFree_;
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_READ_BUFFER_H_ */
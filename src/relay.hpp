@@ -0,0 +1,423 @@
+#ifndef UVCPP_RELAY_H_
+#define UVCPP_RELAY_H_
+#include "stream.hpp"
+#include "poll.hpp"
+#include "read_buffer.hpp"
+#include <array>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#ifndef UVCPP_RELAY_BUF_SIZE
+#define UVCPP_RELAY_BUF_SIZE 16384
+#endif
+
+#ifndef UVCPP_RELAY_HIGH_WATERMARK
+#define UVCPP_RELAY_HIGH_WATERMARK 65536
+#endif
+
+namespace uvcpp {
+
+  /**
+   * published once a relay is over, both streams are closed by then.
+   * status is 0 if both directions reached EOF and were shut down
+   */
+  struct EvRelayEnd : public Event {
+    EvRelayEnd(int status, std::uint64_t bytesAToB, std::uint64_t bytesBToA) :
+      status(status), bytesAToB(bytesAToB), bytesBToA(bytesBToA) { }
+
+    int status;
+    std::uint64_t bytesAToB;
+    std::uint64_t bytesBToA;
+  };
+
+  // relays have no libuv counterpart, Resource only needs the data member
+  struct RelayData {
+    void *data;
+  };
+
+  /**
+   * relays the bytes between two streams in both directions until both
+   * reached EOF, EOF on one side shuts down the write side of the other,
+   * and an error or a close on either side ends the relay. the streams
+   * must stay alive until EvRelayEnd, the relay itself as well, e.g. with
+   * sharedRefUntil<EvRelayEnd>().
+   *
+   * on Linux the bytes are moved with splice(2) through a pipe per
+   * direction and never enter user space, the streams are then left idle
+   * and their dup()ed descriptors are polled. elsewhere, or if a stream
+   * has queued writes or is an ipc pipe, the bytes are read into pooled
+   * buffers that are written to the other stream as they are, with the
+   * writer's watermarks pausing the reader.
+   */
+  class Relay : public Resource<RelayData, Relay> {
+    // published to the callback that detaches the typed streams
+    struct EvRelayDetach : public Event { };
+
+    // relay buffers shared by all relays of a loop
+    struct RelayBufferPool : public LoopContext {
+      explicit RelayBufferPool(Loop &loop) :
+        pool(std::make_shared<BufferPool>(UVCPP_RELAY_BUF_SIZE, 256)) { }
+      std::shared_ptr<BufferPool> pool;
+    };
+
+    struct Direction {
+      int src{-1};
+      int dst{-1};
+      int pipe[2]{-1, -1};
+      std::size_t inPipe{0};
+      std::uint64_t bytes{0};
+      bool eof{false};
+      bool done{false};
+      bool wantRead{false};
+      bool wantWrite{false};
+    };
+
+    public:
+      enum class Mode {
+        // splice(2) where possible, copying otherwise
+        AUTO,
+        COPY
+      };
+
+      Relay(const std::shared_ptr<Loop> &loop, Mode mode = Mode::AUTO) :
+        Resource(loop), mode_(mode) { }
+
+      virtual ~Relay() {
+        closeFds();
+      }
+
+      template <typename U1, typename D1, typename U2, typename D2>
+      bool start(Stream<U1, D1> &a, Stream<U2, D2> &b) {
+        if (started_) {
+          return false;
+        }
+        started_ = true;
+
+        // writes gathered by a cork go out before the relayed bytes
+        a.setAutoCork(false);
+        a.uncork();
+        b.setAutoCork(false);
+        b.uncork();
+
+#if defined(__linux__)
+        if (mode_ == Mode::AUTO &&
+            canSplice(reinterpret_cast<uv_stream_t *>(a.get())) &&
+            canSplice(reinterpret_cast<uv_stream_t *>(b.get())) &&
+            startSplice(
+              reinterpret_cast<uv_handle_t *>(a.get()),
+              reinterpret_cast<uv_handle_t *>(b.get()))) {
+          watchStreams(a, b, false);
+          return true;
+        }
+#endif
+        watchStreams(a, b, true);
+        return true;
+      }
+
+      bool isSplicing() const {
+        return splicing_;
+      }
+
+      // ends the relay and closes both streams
+      void stop() {
+        finish(UV_ECANCELED);
+      }
+
+    private:
+      template <typename S1, typename S2>
+      void watchStreams(S1 &a, S2 &b, bool copy) {
+        std::array<Subscription, 8> subs;
+        auto n = 0;
+        watchStream(a, subs, n);
+        watchStream(b, subs, n);
+        if (copy) {
+          auto pool = this->getLoop()->template
+            getContext<RelayBufferPool>().pool;
+          copyDirection(a, b, 0, pool, subs, n);
+          copyDirection(b, a, 1, pool, subs, n);
+        }
+
+        this->template once<EvRelayDetach>(
+          [&a, &b, subs, n](const auto &e, auto &relay) {
+            for (auto i = 0; i < n; ++i) {
+              if (!a.off(subs[i])) {
+                b.off(subs[i]);
+              }
+            }
+            a.setFlowSource(nullptr);
+            b.setFlowSource(nullptr);
+            a.close();
+            b.close();
+          });
+      }
+
+      template <typename S>
+      void watchStream(S &s, std::array<Subscription, 8> &subs, int &n) {
+        subs[n++] = s.template on<EvError>([this](const auto &e, auto &s) {
+          this->finish(e.status);
+        });
+        // read errors close the stream without an EvError. it is kept
+        // when detaching, the relay ends once both streams are closed
+        s.template on<EvClose>([this](const auto &e, auto &s) {
+          ++this->closedStreams_;
+          this->finish(UV_ECONNRESET);
+          this->endIfClosed();
+        });
+      }
+
+      template <typename S1, typename S2>
+      void copyDirection(
+        S1 &src, S2 &dst, int index, const std::shared_ptr<BufferPool> &pool,
+        std::array<Subscription, 8> &subs, int &n) {
+        subs[n++] = src.template on<EvReadOwned>(
+          [this, &dst, index](const auto &e, auto &src) {
+            auto &buffer = const_cast<EvReadOwned &>(e).buffer;
+            dirs_[index].bytes += buffer->getLength();
+            dst.writeAsync(std::move(buffer));
+          });
+        subs[n++] = src.template on<EvEnd>(
+          [this, &dst, index](const auto &e, auto &src) {
+            dirs_[index].eof = true;
+            dst.shutdown();
+          });
+        // kept when detaching, the writes cancelled by the close hand
+        // their buffers back after that
+        dst.template on<EvBufferRecycled>(
+          [pool](const auto &e, auto &dst) {
+            pool->recycle(std::move(const_cast<EvBufferRecycled &>(e).buffer));
+          });
+        subs[n++] = dst.template on<EvShutdown>(
+          [this, index](const auto &e, auto &dst) {
+            if (dirs_[index].eof) {
+              dirs_[index].done = true;
+              this->finishIfDone();
+            }
+          });
+
+        dst.setWriteWatermarks(
+          UVCPP_RELAY_HIGH_WATERMARK, UVCPP_RELAY_HIGH_WATERMARK / 4);
+        dst.setFlowSource(&src);
+        src.setAllowHalfOpen(true);
+        src.readStartOwned(pool);
+      }
+
+      void finishIfDone() {
+        if (dirs_[0].done && dirs_[1].done) {
+          finish(0);
+        }
+      }
+
+      void finish(int status) {
+        if (finished_) {
+          return;
+        }
+        finished_ = true;
+        status_ = status;
+
+        this->template publish<EvRelayDetach>(EvRelayDetach{});
+        if (status < 0) {
+          this->reportError("relay", status);
+        }
+
+        // the descriptors are closed once the polls are
+        if (pollA_) {
+          pollA_->close();
+        }
+        if (pollB_) {
+          pollB_->close();
+        }
+        endIfClosed();
+      }
+
+      void endIfClosed() {
+        if (!finished_ || ended_ || closedStreams_ < 2 ||
+            (splicing_ && closedPolls_ < 2)) {
+          return;
+        }
+        ended_ = true;
+        closeFds();
+        this->template publish<EvRelayEnd>(
+          EvRelayEnd{ status_, dirs_[0].bytes, dirs_[1].bytes });
+      }
+
+      void closeFds() {
+        for (auto &d : dirs_) {
+          for (auto &fd : d.pipe) {
+            if (fd != -1) {
+              ::close(fd);
+              fd = -1;
+            }
+          }
+        }
+        if (fdA_ != -1) {
+          ::close(fdA_);
+          fdA_ = -1;
+        }
+        if (fdB_ != -1) {
+          ::close(fdB_);
+          fdB_ = -1;
+        }
+      }
+
+#if defined(__linux__)
+      static bool canSplice(uv_stream_t *stream) {
+        if (uv_stream_get_write_queue_size(stream) > 0) {
+          return false;
+        }
+        if (stream->type == UV_NAMED_PIPE &&
+            reinterpret_cast<uv_pipe_t *>(stream)->ipc) {
+          return false;
+        }
+        uv_os_fd_t fd;
+        return uv_fileno(reinterpret_cast<uv_handle_t *>(stream), &fd) == 0;
+      }
+
+      bool startSplice(uv_handle_t *a, uv_handle_t *b) {
+        uv_os_fd_t fdA, fdB;
+        uv_fileno(a, &fdA);
+        uv_fileno(b, &fdB);
+
+        // the streams keep their descriptors, the polls watch duplicates
+        fdA_ = dup(fdA);
+        fdB_ = dup(fdB);
+        if (fdA_ == -1 || fdB_ == -1 ||
+            pipe2(dirs_[0].pipe, O_NONBLOCK | O_CLOEXEC) == -1 ||
+            pipe2(dirs_[1].pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+          LOG_W("relay falls back to copying: %s", strerror(errno));
+          closeFds();
+          return false;
+        }
+
+        auto loop = this->getLoop();
+        pollA_ = Poll::createUnique(loop);
+        pollB_ = Poll::createUnique(loop);
+        if (!pollA_ || !pollB_ ||
+            !pollA_->initWithFd(fdA_) || !pollB_->initWithFd(fdB_)) {
+          pollA_.reset();
+          pollB_.reset();
+          closeFds();
+          return false;
+        }
+
+        uv_read_stop(reinterpret_cast<uv_stream_t *>(a));
+        uv_read_stop(reinterpret_cast<uv_stream_t *>(b));
+
+        dirs_[0].src = dirs_[1].dst = fdA_;
+        dirs_[1].src = dirs_[0].dst = fdB_;
+        for (auto poll : { pollA_.get(), pollB_.get() }) {
+          poll->on<EvPoll>([this](const auto &e, auto &p) {
+            this->pump();
+          });
+          poll->on<EvError>([this](const auto &e, auto &p) {
+            this->finish(e.status);
+          });
+          poll->on<EvClose>([this](const auto &e, auto &p) {
+            ++this->closedPolls_;
+            this->endIfClosed();
+          });
+        }
+
+        splicing_ = true;
+        pump();
+        return true;
+      }
+
+      void pump() {
+        for (auto &d : dirs_) {
+          if (finished_) {
+            return;
+          }
+          pumpDirection(d);
+        }
+        if (finished_) {
+          return;
+        }
+        if (dirs_[0].done && dirs_[1].done) {
+          finish(0);
+          return;
+        }
+
+        watch(*pollA_, dirs_[0].wantRead, dirs_[1].wantWrite);
+        watch(*pollB_, dirs_[1].wantRead, dirs_[0].wantWrite);
+      }
+
+      void watch(Poll &poll, bool readable, bool writable) {
+        auto events = (readable ? UV_READABLE : 0) |
+          (writable ? UV_WRITABLE : 0);
+        if (events) {
+          poll.poll(events);
+        } else {
+          poll.stop();
+        }
+      }
+
+      // moves what it can without blocking, and remembers what it waits for
+      void pumpDirection(Direction &d) {
+        const auto flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+        d.wantRead = d.wantWrite = false;
+
+        while (!d.done) {
+          if (d.inPipe > 0) {
+            auto n = splice(
+              d.pipe[0], nullptr, d.dst, nullptr, d.inPipe, flags);
+            if (n > 0) {
+              d.inPipe -= n;
+              d.bytes += n;
+              continue;
+            }
+            if (n < 0 && errno == EAGAIN) {
+              d.wantWrite = true;
+              return;
+            }
+            finish(n < 0 ? -errno : UV_EPIPE);
+            return;
+          }
+
+          if (d.eof) {
+            if (::shutdown(d.dst, SHUT_WR) == -1 && errno != ENOTSOCK) {
+              finish(-errno);
+              return;
+            }
+            d.done = true;
+            return;
+          }
+
+          auto n = splice(
+            d.src, nullptr, d.pipe[1], nullptr, UVCPP_RELAY_BUF_SIZE * 4,
+            flags);
+          if (n > 0) {
+            d.inPipe += n;
+          } else if (n == 0) {
+            d.eof = true;
+          } else if (errno == EAGAIN) {
+            d.wantRead = true;
+            return;
+          } else {
+            finish(-errno);
+            return;
+          }
+        }
+      }
+#endif
+
+    private:
+      Mode mode_;
+      std::array<Direction, 2> dirs_{};
+      std::unique_ptr<Poll> pollA_{nullptr};
+      std::unique_ptr<Poll> pollB_{nullptr};
+      int fdA_{-1};
+      int fdB_{-1};
+      int closedPolls_{0};
+      int closedStreams_{0};
+      int status_{0};
+      bool started_{false};
+      bool splicing_{false};
+      bool finished_{false};
+      bool ended_{false};
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_RELAY_H_ */
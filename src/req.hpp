@@ -7,6 +7,11 @@
 #include "util.hpp"
 #include "util/buffer.hpp"
 
+// number of free requests a ReqPool keeps per request type and loop
+#ifndef UVCPP_REQ_POOL_SIZE
+#define UVCPP_REQ_POOL_SIZE 256
+#endif
+
 namespace uvcpp {
   struct EvWork : public Event { };
   struct EvAfterWork : public Event { };
@@ -18,27 +23,185 @@ namespace uvcpp {
     DNSResultVector dnsResults;
   };
 
+  /**
+   * FIFO of requests linked through their next member, unlike std::deque
+   * it allocates nothing by itself
+   */
+  template <typename R>
+  class ReqQueue {
+    public:
+      ReqQueue() = default;
+      ReqQueue(const ReqQueue &) = delete;
+      ReqQueue &operator=(const ReqQueue &) = delete;
+
+      ~ReqQueue() {
+        clear();
+      }
+
+      bool empty() const {
+        return !head_;
+      }
+
+      void push(std::unique_ptr<R> req) {
+        auto rawReq = req.get();
+        if (tail_) {
+          tail_->next = std::move(req);
+        } else {
+          head_ = std::move(req);
+        }
+        tail_ = rawReq;
+      }
+
+      std::unique_ptr<R> pop() {
+        auto req = std::move(head_);
+        if (req) {
+          head_ = std::move(req->next);
+          if (!head_) {
+            tail_ = nullptr;
+          }
+        }
+        return req;
+      }
+
+      template <typename Fn>
+      void forEach(Fn &&fn) {
+        for (auto r = head_.get(); r; r = r->next.get()) {
+          fn(*r);
+        }
+      }
+
+      // unlinks the requests one by one, a long chain of unique_ptrs
+      // would otherwise be destroyed recursively
+      void clear() {
+        while (head_) {
+          pop();
+        }
+      }
+
+    private:
+      std::unique_ptr<R> head_{nullptr};
+      R *tail_{nullptr};
+  };
+
+  // requests rarely have callbacks, so no callback slots are embedded
   template <typename T, typename Derived>
-  class Req : public Resource<T, Derived> {
+  class Req : public Resource<T, Derived, 0> {
     public:
-      Req(const std::shared_ptr<Loop> &loop) : Resource<T, Derived>(loop) { }
+      Req(const std::shared_ptr<Loop> &loop) : Resource<T, Derived, 0>(loop) { }
       void cancel() {
         uv_cancel(reinterpret_cast<uv_req_t *>(this->get()));
       }
   };
 
-  class WriteReq : public Req<uv_write_t, WriteReq> {
+  /**
+   * request without the event bus and the loop reference of Req, for the
+   * requests handles issue internally and complete in their own callbacks
+   */
+  template <typename T>
+  class LiteReq {
     public:
-      WriteReq(const std::shared_ptr<Loop> &loop, std::unique_ptr<nul::Buffer> buffer) :
-        Req(loop), buffer(std::move(buffer)) { }
+      LiteReq() {
+        req_.data = this;
+      }
+      LiteReq(const LiteReq &) = delete;
+      LiteReq &operator=(const LiteReq &) = delete;
+
+      T *get() {
+        return &req_;
+      }
+
+    private:
+      T req_;
+  };
+
+  /**
+   * per-loop freelist of LiteReqs, linked through their next member, R
+   * provides reset() to drop what the previous use left behind
+   */
+  template <typename R>
+  class ReqPool : public LoopContext {
+    public:
+      explicit ReqPool(Loop &loop) { }
+
+      static ReqPool &of(uv_loop_t *loop) {
+        return Loop::fromRaw(loop)->getContext<ReqPool>();
+      }
+
+      std::unique_ptr<R> acquire() {
+        if (auto req = free_.pop()) {
+          --freeCount_;
+          return req;
+        }
+        return std::make_unique<R>();
+      }
+
+      void recycle(std::unique_ptr<R> req) {
+        if (freeCount_ >= UVCPP_REQ_POOL_SIZE) {
+          return;
+        }
+        req->reset();
+        free_.push(std::move(req));
+        ++freeCount_;
+      }
+
+      std::size_t getFreeCount() const {
+        return freeCount_;
+      }
+
+    private:
+      ReqQueue<R> free_{};
+      std::size_t freeCount_{0};
+  };
+
+  using BufferVector = std::vector<std::unique_ptr<nul::Buffer>>;
+
+  /**
+   * the write, send and shutdown requests of the handles are LiteReqs
+   * taken from the ReqPool of their loop, they used to be Req resources.
+   * code that created them with createUnique()/createShared(), or
+   * subscribed to them with on(), acquires them from ReqPool<R>::of()
+   * instead and handles the completion in the libuv callback, where the
+   * data member of the libuv request points to the LiteReq.
+   */
+  class WriteReq : public LiteReq<uv_write_t> {
+    public:
+      void reset() {
+        buffer.reset();
+        buffers.reset();
+        handler = nullptr;
+      }
+
+      template <typename Fn>
+      void forEachBuffer(Fn &&fn) {
+        if (buffer) {
+          fn(std::move(buffer));
+        }
+        if (buffers) {
+          for (auto &b : *buffers) {
+            if (b) {
+              fn(std::move(b));
+            }
+          }
+          buffers.reset();
+        }
+      }
+
       std::unique_ptr<nul::Buffer> buffer;
+      // boxed, so that single buffer writes pay one pointer for it
+      std::unique_ptr<BufferVector> buffers{nullptr};
+      // of the static writes, see Stream::writeAsync()
+      void *handler{nullptr};
+      std::unique_ptr<WriteReq> next{nullptr};
   };
 
-  class UdpSendReq : public Req<uv_udp_send_t, UdpSendReq> {
+  class UdpSendReq : public LiteReq<uv_udp_send_t> {
     public:
-      UdpSendReq(const std::shared_ptr<Loop> &loop, std::unique_ptr<nul::Buffer> buffer) :
-        Req(loop), buffer(std::move(buffer)) { }
+      void reset() {
+        buffer.reset();
+      }
+
       std::unique_ptr<nul::Buffer> buffer;
+      std::unique_ptr<UdpSendReq> next{nullptr};
   };
 
   class ConnectReq : public Req<uv_connect_t, ConnectReq> {
@@ -46,9 +209,12 @@ namespace uvcpp {
       ConnectReq(const std::shared_ptr<Loop> &loop) : Req(loop) { }
   };
 
-  class ShutdownReq : public Req<uv_shutdown_t, ShutdownReq> {
+  // taken from the ReqPool of the loop for the time of a shutdown
+  class ShutdownReq : public LiteReq<uv_shutdown_t> {
     public:
-      ShutdownReq(const std::shared_ptr<Loop> &loop) : Req(loop) { }
+      void reset() { }
+
+      std::unique_ptr<ShutdownReq> next{nullptr};
   };
 
   class Work : public Req<uv_work_t, Work> {
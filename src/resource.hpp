@@ -1,5 +1,6 @@
 #ifndef UVCPP_RESOURCE_H_
 #define UVCPP_RESOURCE_H_
+#include <atomic>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -7,6 +8,7 @@
 #include <vector>
 #include "uv.h"
 #include "loop.hpp"
+#include "callback.hpp"
 #include "util/log.hpp"
 
 namespace uvcpp {
@@ -25,23 +27,34 @@ namespace uvcpp {
   template <typename E, typename Derived>
   using EventCallback = std::function<void(const E &event, Derived &handle)>;
 
-  struct CallbackInterface {
-    virtual ~CallbackInterface() { }
+  /**
+   * specialize EventTraits for a Resource type to list the events it
+   * publishes, ids of the listed events are compile time constants and
+   * each of them gets its own callback list, so publishing them costs
+   * only a walk over their own callbacks. events not in the list still
+   * work, with ids assigned at runtime.
+   */
+  template <typename Derived>
+  struct EventTraits {
+    using Events = EventList<>;
   };
 
-  template <typename E, typename Derived>
-  struct Callback : public CallbackInterface {
-    Callback(EventCallback<E, Derived> callback) : callback(callback) { }
-    EventCallback<E, Derived> callback;
-  };
-
-  template <typename T, typename Derived>
-  class Resource : public std::enable_shared_from_this<Resource<T, Derived>> {
+  /**
+   * InlineSlots is the number of callback slots embedded in the resource,
+   * see CallbackStore
+   */
+  template <
+    typename T, typename Derived,
+    std::size_t InlineSlots = UVCPP_CALLBACK_INLINE_SLOTS>
+  class Resource : public std::enable_shared_from_this<
+                     Resource<T, Derived, InlineSlots>> {
     enum class CallbackType {
       ALWAYS,
       ONCE
     };
 
+    using Events = typename EventTraits<Derived>::Events;
+
     public:
       using Type = T;
       explicit Resource(const std::shared_ptr<Loop> &loop) : loop_(loop) {
@@ -59,7 +72,8 @@ namespace uvcpp {
         return loop_;
       }
 
-      using std::enable_shared_from_this<Resource<T, Derived>>::shared_from_this;
+      using std::enable_shared_from_this<
+        Resource<T, Derived, InlineSlots>>::shared_from_this;
       // only call this method on std::shread_ptr
       template<typename E, typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
       void sharedRefUntil() {
@@ -67,8 +81,14 @@ namespace uvcpp {
           [_ = shared_from_this()](const auto &, auto &){});
       }
 
-      template<typename E, typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
-      void on(EventCallback<E, Derived> &&callback) {
+      /**
+       * the callback can be any callable with the signature of
+       * EventCallback<E, Derived>, it is stored without being wrapped
+       * in std::function, small ones do not allocate at all.
+       * the returned Subscription can be passed to off() to remove it.
+       */
+      template<typename E, typename F, typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
+      Subscription on(F &&callback) {
         const auto cbType =
           (std::is_same<E, EvError>::value ||
            std::is_same<E, EvRef>::value ||
@@ -76,24 +96,33 @@ namespace uvcpp {
           CallbackType::ONCE :
           CallbackType::ALWAYS;
 
-        registerCallback<E, cbType>(
-          std::forward<EventCallback<E, Derived>>(callback));
+        return registerCallback<E, cbType>(std::forward<F>(callback));
       }
 
-      template<typename E, typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
-      void once(EventCallback<E, Derived> &&callback) {
-        registerCallback<E, CallbackType::ONCE>(
-          std::forward<EventCallback<E, Derived>>(callback));
+      template<typename E, typename F, typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
+      Subscription once(F &&callback) {
+        return registerCallback<E, CallbackType::ONCE>(
+          std::forward<F>(callback));
+      }
+
+      /**
+       * removes a callback registered with on()/once(), can be called from
+       * within any callback including the one being removed, returns false
+       * if the callback was already removed or, for ONCE callbacks, called
+       */
+      bool off(const Subscription &subscription) {
+        return callbacks_.remove(subscription);
       }
 
       template<typename E, typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
       void publish(E &&event) {
+        auto index = getEventTypeIndex<E>();
         if (!std::is_same<E, EvError>::value &&
             !std::is_same<E, EvRef>::value &&
             !std::is_same<E, EvDestroy>::value) {
-          doCallback<E, CallbackType::ALWAYS>(std::forward<E>(event));
+          callbacks_.dispatch(index, &event, static_cast<Derived *>(this));
         }
-        doCallback<E, CallbackType::ONCE>(std::forward<E>(event));
+        callbacks_.dispatchOnce(index, &event, static_cast<Derived *>(this));
       }
 
       template <typename U = Derived, typename ...Args, typename =
@@ -113,58 +142,61 @@ namespace uvcpp {
         publish<EvError>(EvError{ err });
       }
 
+      // drops all the subscriptions, for resources that are reused
+      void clearCallbacks() {
+        callbacks_.clear();
+      }
+
+      /**
+       * for resources kept by a LoopContext of their own loop, which would
+       * otherwise never be freed: getLoop() still returns the loop, but
+       * without owning it, until adoptLoop() hands an owning one back
+       */
+      void disownLoop() {
+        loop_ = std::shared_ptr<Loop>(std::shared_ptr<Loop>(), loop_.get());
+      }
+
+      void adoptLoop(const std::shared_ptr<Loop> &loop) {
+        loop_ = loop;
+      }
+
     private:
       template<
-        typename E, CallbackType t,
+        typename E, CallbackType t, typename F,
         typename = std::enable_if_t<std::is_base_of<Event, E>::value, E>>
-      void registerCallback(EventCallback<E, Derived> &&callback) {
-        auto &vec = t == CallbackType::ALWAYS ? callbacks_ : onceCallbacks_;
-        auto index = getEventTypeIndex<E, t>();
-        if (index >= vec.size()) {
-          vec.resize(index + 1);
-        }
-        vec[index].push_back(std::make_unique<Callback<E, Derived>>(
-            std::forward<EventCallback<E, Derived>>(callback)));
-      }
-
-      template<typename E, CallbackType t>
-      void doCallback(E &&event) {
-        auto index = getEventTypeIndex<E, t>();
-        if (t == CallbackType::ALWAYS) {
-          if (index < callbacks_.size()) {
-            auto &tmp = callbacks_[index];
-            for (auto &c : tmp) {
-              static_cast<Callback<E, Derived> *>(c.get())
-                ->callback(std::forward<E>(event), static_cast<Derived &>(*this));
-            }
-          }
-        } else if (index < onceCallbacks_.size()) {
-          std::vector<std::unique_ptr<CallbackInterface>> tmp;
-          onceCallbacks_[index].swap(tmp);
-          for (auto &c : tmp) {
-            static_cast<Callback<E, Derived> *>(c.get())
-              ->callback(std::forward<E>(event), static_cast<Derived &>(*this));
-          }
-        }
+      Subscription registerCallback(F &&callback) {
+        return callbacks_.template add<E, Derived>(
+          getEventTypeIndex<E>(), t == CallbackType::ONCE,
+          std::forward<F>(callback));
       }
 
-      template <CallbackType>
-      static std::size_t countEventTypeIndex() {
-        static std::size_t index = 0;
+      // resources of the same type may live on loops of other threads
+      static std::uint32_t countEventTypeIndex() {
+        static std::atomic<std::uint32_t> index{Events::size};
         return index++;
       }
 
-      template <typename E, CallbackType t>
-      static std::size_t getEventTypeIndex() {
-        static std::size_t index = countEventTypeIndex<t>();
+      template <typename E>
+      static std::uint32_t getEventTypeIndex() {
+        return getEventTypeIndex<E>(std::integral_constant<bool,
+          (EventIndex<E, Events>::value < Events::size)>{});
+      }
+
+      template <typename E>
+      static constexpr std::uint32_t getEventTypeIndex(std::true_type) {
+        return EventIndex<E, Events>::value;
+      }
+
+      template <typename E>
+      static std::uint32_t getEventTypeIndex(std::false_type) {
+        static std::uint32_t index = countEventTypeIndex();
         return index;
       }
     
     private:
       std::shared_ptr<Loop> loop_;
       T resource_;
-      std::vector<std::vector<std::unique_ptr<CallbackInterface>>> callbacks_{};
-      std::vector<std::vector<std::unique_ptr<CallbackInterface>>> onceCallbacks_{};
+      CallbackStore<InlineSlots, Events::size> callbacks_{};
   };
 } /* end of namspace: uvcpp */
 
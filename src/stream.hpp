@@ -8,9 +8,20 @@
 #define UVCPP_STREAM_H_
 #include "handle.hpp"
 #include "req.hpp"
+#include "read_buffer.hpp"
+#include "poll.hpp"
+#include "timer_wheel.hpp"
 #include "defs.h"
-#include <deque>
 #include <cassert>
+#include <cerrno>
+#include <limits>
+#include <unistd.h>
+
+// bytes handed to one uv_fs_sendfile() call, where libuv emulates
+// sendfile(2) the call holds a thread pool thread until the socket took them
+#ifndef UVCPP_SENDFILE_CHUNK_SIZE
+#define UVCPP_SENDFILE_CHUNK_SIZE (1024 * 1024)
+#endif
 
 namespace uvcpp {
   struct EvConnect : public Event { };
@@ -30,13 +41,89 @@ namespace uvcpp {
     ssize_t nread;
   };
 
+  /**
+   * published instead of EvRead in the owned read mode, the buffer libuv
+   * filled is moved into the event, so it can be kept or written to another
+   * stream without copying. buffers that are not moved out of the event are
+   * returned to the pool.
+   */
+  struct EvReadOwned : public Event {
+    EvReadOwned(std::unique_ptr<nul::Buffer> buffer) :
+      buffer(std::move(buffer)) { }
+
+    std::unique_ptr<nul::Buffer> buffer;
+  };
+
   struct EvWrite : public Event { };
+
+  /**
+   * published instead of closing the stream when the peer shut down its
+   * write side, if half open streams are allowed, reading is stopped
+   */
+  struct EvEnd : public Event { };
+
+  /**
+   * published when the bytes queued for writing rise above the high
+   * watermark and when they fall back to the low watermark, see
+   * Stream::setWriteWatermarks()
+   */
+  struct EvWriteBlocked : public Event { };
+  struct EvWritable : public Event { };
+
   struct EvShutdown : public Event { };
 
+  // published after every chunk of a Stream::sendFile()
+  struct EvSendFileProgress : public Event {
+    EvSendFileProgress(std::uint64_t sent, std::uint64_t length) :
+      sent(sent), length(length) { }
+
+    std::uint64_t sent;
+    std::uint64_t length;
+  };
+
+  /**
+   * published once a Stream::sendFile() is over, status is UV_EOF if the
+   * file ended before the region did
+   */
+  struct EvSendFile : public Event {
+    EvSendFile(int status, std::uint64_t sent) : status(status), sent(sent) { }
+
+    int status;
+    std::uint64_t sent;
+  };
+
+  /**
+   * published right before a stream is closed for one of its timeouts, a
+   * connect that timed out also fails with UV_ECANCELED after it
+   */
+  struct EvTimeout : public Event {
+    enum class Type {
+      CONNECT,
+      IDLE,
+      READ
+    };
+
+    EvTimeout(Type type) : type(type) { }
+
+    Type type;
+  };
+
   template <typename T, typename Derived>
     class Stream : public Handle<T, Derived> {
       public:
         Stream(const std::shared_ptr<Loop> &loop) : Handle<T, Derived>(loop) { }
+        virtual ~Stream() {
+          if (cork_) {
+            Loop::fromRaw(this->get()->loop)->cancelBeforePoll(cork_.get());
+          }
+          // the request in flight owns the state from now on
+          if (fileSend_ && fileSend_->inFlight) {
+            uv_cancel(reinterpret_cast<uv_req_t *>(&fileSend_->req));
+            fileSend_->stream = nullptr;
+            fileSend_.release();
+          }
+        }
+
         bool listen(int backlog) {
           int err;
           if ((err = uv_listen(reinterpret_cast<uv_stream_t *>(this->get()),
@@ -53,7 +140,26 @@ namespace uvcpp {
                 reinterpret_cast<uv_stream_t *>(this->get()),
                 onAllocCallback, onReadCallback)) != 0) {
             this->reportError("uv_read_start", err);
+            return;
           }
+          setReading(true);
+        }
+
+        /**
+         * owned read mode, reads go to buffers taken from pool and are
+         * published as EvReadOwned, read buffer policies are not used
+         */
+        void readStartOwned(std::shared_ptr<BufferPool> pool) {
+          ownedReadPool_ = std::move(pool);
+
+          int err;
+          if ((err = uv_read_start(
+                reinterpret_cast<uv_stream_t *>(this->get()),
+                onOwnedAllocCallback, onOwnedReadCallback)) != 0) {
+            this->reportError("uv_read_start", err);
+            return;
+          }
+          setReading(true);
         }
 
         void readStop() {
@@ -62,50 +168,322 @@ namespace uvcpp {
                 reinterpret_cast<uv_stream_t *>(this->get()))) != 0) {
             this->reportError("uv_read_stop", err);
           }
+          setReading(false);
         }
 
         void shutdown() {
-          if (!shutdownReq_) {
-            shutdownReq_ = ShutdownReq::createUnique(this->getLoop());
+          if (isSendingFile()) {
+            fileSend_->shutdownAfter = true;
+            return;
           }
+          flushCorked();
+          auto &pool = ReqPool<ShutdownReq>::of(this->get()->loop);
+          auto req = pool.acquire();
 
           int err;
           if ((err = uv_shutdown(
-                shutdownReq_->get(),
+                req->get(),
                 reinterpret_cast<uv_stream_t *>(this->get()),
                 onShutdownCallback)) != 0) {
+            pool.recycle(std::move(req));
             this->reportError("uv_shutdown", err);
+            return;
           }
+          // back to the pool in onShutdownCallback
+          req.release();
         }
 
         bool writeAsync(std::unique_ptr<nul::Buffer> buffer) {
+          if (isCorking()) {
+            return gatherCorked(std::move(buffer));
+          }
+          return doWriteAsync(std::move(buffer), onWriteCallback);
+        }
+
+        /**
+         * writes all the buffers with one uv_write and one request, like
+         * writev, the buffers are handed back in order with
+         * EvBufferRecycled followed by one EvWrite once the write completes
+         */
+        bool writeAsync(BufferVector buffers) {
+          if (isCorking()) {
+            for (auto &buffer : buffers) {
+              if (!gatherCorked(std::move(buffer))) {
+                return false;
+              }
+            }
+            return true;
+          }
+          return doWritevAsync(std::move(buffers));
+        }
+
+        /**
+         * writes as much as the socket takes right away with uv_try_write()
+         * and queues only the rest like writeAsync(). a buffer written in
+         * full is handed back with EvBufferRecycled before write() returns,
+         * without a request or an EvWrite, EvWrite is only published for
+         * the queued rest. libuv refuses to try while earlier writes are
+         * queued, so the data always goes out in order.
+         */
+        bool write(std::unique_ptr<nul::Buffer> buffer) {
+          if (isCorking()) {
+            return gatherCorked(std::move(buffer));
+          }
           if (!this->isValid()) {
             return false;
           }
 
-          auto rawBuffer = buffer->asPod();
-          auto req = WriteReq::createUnique(this->getLoop(), std::move(buffer));
-          auto rawReq = req->get();
-          pendingReqs_.push_back(std::move(req));
+          auto rawBuffer = uv_buf_init(
+            buffer->getData(), static_cast<unsigned int>(buffer->getLength()));
+          auto written = uv_try_write(
+            reinterpret_cast<uv_stream_t *>(this->get()), &rawBuffer, 1);
+          if (written < 0) {
+            // UV_EAGAIN, or an error uv_write() reports the usual way
+            written = 0;
+          }
+
+          if (static_cast<std::size_t>(written) == buffer->getLength()) {
+            this->template publish<EvBufferRecycled>(
+              EvBufferRecycled{ std::move(buffer) });
+            return true;
+          }
+          return doWriteAsync(std::move(buffer), onWriteCallback, written);
+        }
+
+        /**
+         * EvWriteBlocked is published once the bytes queued in libuv exceed
+         * high and EvWritable once they are back at or below low, high == 0
+         * turns the watermarks off
+         */
+        void setWriteWatermarks(std::size_t high, std::size_t low) {
+          auto flow = getFlowState();
+          flow->high = high;
+          flow->low = low < high ? low : high;
+          checkWriteBlocked();
+          checkWritable();
+        }
+
+        bool isWriteBlocked() const {
+          return flow_ && flow_->blocked;
+        }
+
+        std::size_t getWriteQueueSize() {
+          return uv_stream_get_write_queue_size(
+            reinterpret_cast<uv_stream_t *>(this->get()));
+        }
+
+        /**
+         * reading of source is stopped while this stream is write blocked
+         * and started again with the same callbacks once it is writable or
+         * closed, end to end flow control for relays. source must stay
+         * alive until unpaired with nullptr.
+         */
+        template <typename U, typename D>
+        void setFlowSource(Stream<U, D> *source) {
+          auto flow = getFlowState();
+          resumeFlowSource();
+          flow->source = source ?
+            reinterpret_cast<uv_stream_t *>(source->get()) : nullptr;
+          if (flow->blocked) {
+            pauseFlowSource();
+          }
+        }
+
+        void setFlowSource(std::nullptr_t) {
+          if (flow_) {
+            resumeFlowSource();
+            flow_->source = nullptr;
+          }
+        }
+
+        /**
+         * while corked, writeAsync() only gathers the buffers and uncork()
+         * sends all of them with one vectored write. with auto cork on, the
+         * writes of a loop iteration are gathered and sent right before the
+         * loop polls for I/O. either way one EvWrite is published per flush
+         * and EvBufferRecycled for every buffer. writes of the static
+         * handlers are not gathered, they, shutdown() and writeSync() send
+         * the gathered buffers first.
+         */
+        void cork() {
+          getCorkState()->corked = true;
+        }
+
+        bool uncork() {
+          if (!cork_) {
+            return true;
+          }
+          cork_->corked = false;
+          return flushCorked();
+        }
+
+        void setAutoCork(bool autoCork) {
+          if (autoCork) {
+            getCorkState()->autoCork = true;
+          } else if (cork_) {
+            cork_->autoCork = false;
+            if (!cork_->corked) {
+              flushCorked();
+            }
+          }
+        }
+
+        /**
+         * static counterparts of readStart() and writeAsync(), data read
+         * from the stream is passed to handler.onRead(buf, nread) and write
+         * completions to handler.onWrite(std::move(buffer), status) instead
+         * of being published as EvRead, EvWrite and EvBufferRecycled. the
+         * calls are resolved at compile time, so they can be inlined into
+         * the libuv callbacks. errors and EvClose still go through the
+         * events. the stream keeps one read handler, the handler of a write
+         * is kept by its request, so writes may go to handlers of their own.
+         * a write libuv refuses hands its buffer back to handler.onWrite()
+         * right away.
+         */
+        template <typename Handler>
+        void readStart(Handler &handler) {
+          readHandler_ = &handler;
 
           int err;
-          if ((err = uv_write(
-                rawReq,
+          if ((err = uv_read_start(
                 reinterpret_cast<uv_stream_t *>(this->get()),
-                reinterpret_cast<uv_buf_t *>(rawBuffer),
-                1, onWriteCallback)) != 0) {
-            this->reportError("uv_write", err);
+                onAllocCallback, onStaticReadCallback<Handler>)) != 0) {
+            this->reportError("uv_read_start", err);
+            return;
+          }
+          setReading(true);
+        }
+
+        template <typename Handler>
+        bool writeAsync(std::unique_ptr<nul::Buffer> buffer, Handler &handler) {
+          if (!this->isValid()) {
+            return false;
+          }
+          // the handler is per request, so it is not gathered, it neither
+          // overtakes the gathered buffers nor the file being sent
+          flushCorked();
+          if (isSendingFile()) {
+            handler.onWrite(std::move(buffer), UV_EAGAIN);
+            return false;
+          }
+
+          auto &pool = ReqPool<WriteReq>::of(this->get()->loop);
+          auto req = pool.acquire();
+          req->buffer = std::move(buffer);
+          req->handler = &handler;
+          int err;
+          if ((err = submitWrite(
+                req, 0, onStaticWriteCallback<Handler>)) != 0) {
+            auto failed = std::move(req->buffer);
+            pool.recycle(std::move(req));
+            handler.onWrite(std::move(failed), err);
             return false;
           }
           return true;
         }
 
+        /**
+         * where reads of this stream go, overrides the policy of the loop,
+         * nullptr falls back to the loop policy or the built-in buffer
+         */
+        void setReadBufferPolicy(std::shared_ptr<ReadBufferPolicy> policy) {
+          readBufferPolicy_ = std::move(policy);
+        }
+
+        /**
+         * sends length bytes of the file from offset on with
+         * uv_fs_sendfile(), the bytes go from the page cache to the socket
+         * on the thread pool, a chunk at a time, and the next chunk waits
+         * for the socket to be writable. it starts once the queued writes
+         * are done, writes and shutdown() issued meanwhile are held back
+         * until it is over, writes of the static handlers are handed back
+         * with UV_EAGAIN, as writeSync() fails. EvSendFileProgress is
+         * published per chunk and EvSendFile at the end, fd stays owned by
+         * the caller. one file at a time per stream.
+         */
+        bool sendFile(uv_file fd, std::int64_t offset, std::uint64_t length) {
+          if (!this->isValid() || isSendingFile()) {
+            return false;
+          }
+          flushCorked();
+
+          if (!fileSend_) {
+            fileSend_ = std::make_unique<FileSendState>(this);
+          }
+          auto fs = fileSend_.get();
+          fs->fd = fd;
+          fs->offset = offset;
+          fs->length = length;
+          fs->sent = 0;
+          fs->active = true;
+          fs->shutdownAfter = false;
+
+          int err;
+          if (length == 0) {
+            finishSendFile(0);
+          } else if ((err = dupSendFileSocket()) != 0) {
+            finishSendFile(err);
+          } else if (!pendingReqs_.empty()) {
+            fs->waitingWrites = true;
+          } else {
+            sendFileChunk();
+          }
+          return true;
+        }
+
+        bool isSendingFile() const {
+          return fileSend_ && fileSend_->active;
+        }
+
+        /**
+         * by default a stream is closed once the peer shut down its write
+         * side, with half open streams allowed EvEnd is published instead
+         * and the stream can still be written to
+         */
+        void setAllowHalfOpen(bool allow) {
+          allowHalfOpen_ = allow;
+        }
+
+        /**
+         * the timeouts close the stream after publishing EvTimeout, they
+         * are in milliseconds and 0 turns them off. they run on the
+         * TimerWheel of the loop, a read or a write only stores the time,
+         * so they can be set on every connection.
+         *
+         * the connect timeout is for the connect() that follows
+         */
+        void setConnectTimeout(uint64_t timeout) {
+          getTimeoutState()->connectTimeout = timeout;
+        }
+
+        // no bytes read or written for timeout
+        void setIdleTimeout(uint64_t timeout) {
+          auto ts = getTimeoutState();
+          ts->idleTimeout = timeout;
+          ts->lastActivity = uv_now(this->get()->loop);
+          armTimeout();
+        }
+
+        // no bytes read for timeout while reading
+        void setReadTimeout(uint64_t timeout) {
+          auto ts = getTimeoutState();
+          ts->readTimeout = timeout;
+          ts->lastRead = uv_now(this->get()->loop);
+          armTimeout();
+        }
+
         /**
          * > 0: number of bytes written (can be less than the supplied buffer size).
          * < 0: negative error code (UV_EAGAIN is returned if no data can be sent immediately).
          */
         int writeSync(const nul::Buffer &buf) {
           //uv_buf_t buf = { .base = const_cast<char *>(data), .len = len };
+          // queued behind the gathered buffers, uv_try_write() then fails
+          // with UV_EAGAIN rather than overtaking them
+          flushCorked();
+          if (isSendingFile()) {
+            return UV_EAGAIN;
+          }
           int err;
           if ((err = uv_try_write(
                 reinterpret_cast<uv_stream_t *>(this->get()),
@@ -115,27 +493,414 @@ namespace uvcpp {
           return err;
         }
 
-        virtual bool init() override {
-          if (!Handle<T, Derived>::init()) {
+      protected:
+        virtual void doAccept() = 0;
+
+        // called by connect() once the request is issued
+        void startConnectTimeout() {
+          if (timeouts_) {
+            timeouts_->connecting = true;
+            timeouts_->connectStart = uv_now(this->get()->loop);
+            armTimeout();
+          }
+        }
+
+        // called by the connect callback, whatever the status
+        void stopConnectTimeout() {
+          if (timeouts_ && timeouts_->connecting) {
+            timeouts_->connecting = false;
+            timeouts_->lastActivity = uv_now(this->get()->loop);
+            armTimeout();
+          }
+        }
+
+        // if pendingReqs are not empty after being closed
+        // the buffers should be recycled
+        virtual void onClose() override {
+          pendingReqs_.forEach([this](auto &r){
+            this->recycleBuffers(r);
+          });
+          pendingReqs_.clear();
+
+          if (ownedReadBuf_) {
+            ownedReadPool_->recycle(std::move(ownedReadBuf_));
+          }
+
+          if (flow_) {
+            resumeFlowSource();
+          }
+
+          if (timeouts_) {
+            timeouts_->entry.cancel();
+          }
+
+          // the request in flight finishes it otherwise
+          if (fileSend_ && !fileSend_->inFlight) {
+            finishSendFile(UV_ECANCELED);
+          } else if (fileSend_) {
+            uv_cancel(reinterpret_cast<uv_req_t *>(&fileSend_->req));
+          }
+
+          if (cork_) {
+            Loop::fromRaw(this->get()->loop)->cancelBeforePoll(cork_.get());
+            for (auto &buffer : cork_->buffers) {
+              this->template publish<EvBufferRecycled>(
+                EvBufferRecycled{ std::move(buffer) });
+            }
+            cork_->buffers.clear();
+          }
+        }
+
+        // writes buffer from offset on, the bytes before it were written
+        // with uv_try_write()
+        bool doWriteAsync(
+          std::unique_ptr<nul::Buffer> buffer, uv_write_cb cb,
+          std::size_t offset = 0) {
+          if (!this->isValid()) {
             return false;
           }
 
-          // if pendingReqs are not empty after being closed
-          // the buffers should be recycled
-          this->template once<EvClose>([this](const auto &e, auto &st){
-            if (!pendingReqs_.empty()) {
-              for (auto &r : pendingReqs_) {
-                this->template publish<EvBufferRecycled>(
-                  EvBufferRecycled{ std::move(r->buffer) });
-              }
-              pendingReqs_.clear();
+          auto &pool = ReqPool<WriteReq>::of(this->get()->loop);
+          auto req = pool.acquire();
+          req->buffer = std::move(buffer);
+          if (submitWrite(req, offset, cb) != 0) {
+            recycleBuffers(*req);
+            pool.recycle(std::move(req));
+            return false;
+          }
+          return true;
+        }
+
+        // queues req once libuv took it, a refused req is left to the
+        // caller, so that it never completes the writes queued after it
+        int submitWrite(
+          std::unique_ptr<WriteReq> &req, std::size_t offset, uv_write_cb cb) {
+          auto &buffer = req->buffer;
+          auto rawBuffer = uv_buf_init(
+            buffer->getData() + offset,
+            static_cast<unsigned int>(buffer->getLength() - offset));
+
+          int err;
+          if ((err = uv_write(
+                req->get(),
+                reinterpret_cast<uv_stream_t *>(this->get()),
+                &rawBuffer, 1, cb)) != 0) {
+            this->reportError("uv_write", err);
+            return err;
+          }
+          pendingReqs_.push(std::move(req));
+          checkWriteBlocked();
+          return 0;
+        }
+
+        bool isCorking() const {
+          return (cork_ && (cork_->corked || cork_->autoCork)) ||
+            isSendingFile();
+        }
+
+        bool gatherCorked(std::unique_ptr<nul::Buffer> buffer) {
+          if (!this->isValid()) {
+            return false;
+          }
+          getCorkState();
+          if (cork_->buffers.empty()) {
+            cork_->buffers.reserve(8);
+          }
+          cork_->buffers.push_back(std::move(buffer));
+          if (!cork_->corked &&
+              !Loop::fromRaw(this->get()->loop)->runBeforePoll(cork_.get())) {
+            return flushCorked();
+          }
+          return true;
+        }
+
+        bool flushCorked() {
+          if (!cork_ || cork_->buffers.empty()) {
+            return true;
+          }
+          // left for onClose() to recycle
+          if (!this->isValid()) {
+            return false;
+          }
+          // sent once the file is
+          if (isSendingFile()) {
+            return true;
+          }
+          Loop::fromRaw(this->get()->loop)->cancelBeforePoll(cork_.get());
+
+          auto buffers = std::move(cork_->buffers);
+          cork_->buffers.clear();
+          if (buffers.size() == 1) {
+            return doWriteAsync(std::move(buffers.front()), onWriteCallback);
+          }
+          return doWritevAsync(std::move(buffers));
+        }
+
+        void checkWriteBlocked() {
+          if (flow_ && !flow_->blocked && flow_->high > 0 &&
+              getWriteQueueSize() > flow_->high) {
+            flow_->blocked = true;
+            pauseFlowSource();
+            this->template publish<EvWriteBlocked>(EvWriteBlocked{});
+          }
+        }
+
+        void checkWritable() {
+          if (flow_ && flow_->blocked &&
+              (flow_->high == 0 || getWriteQueueSize() <= flow_->low)) {
+            flow_->blocked = false;
+            resumeFlowSource();
+            this->template publish<EvWritable>(EvWritable{});
+          }
+        }
+
+        // libuv forgets the callbacks in uv_read_stop(), they are kept
+        // here to restart reading the same way
+        void pauseFlowSource() {
+          auto source = flow_->source;
+          if (!source || flow_->sourcePaused || !source->read_cb ||
+              uv_is_closing(reinterpret_cast<uv_handle_t *>(source))) {
+            return;
+          }
+          flow_->sourceAllocCb = source->alloc_cb;
+          flow_->sourceReadCb = source->read_cb;
+          flow_->sourcePaused = true;
+          uv_read_stop(source);
+        }
+
+        void resumeFlowSource() {
+          if (!flow_->sourcePaused) {
+            return;
+          }
+          flow_->sourcePaused = false;
+          auto source = flow_->source;
+          if (!uv_is_closing(reinterpret_cast<uv_handle_t *>(source))) {
+            uv_read_start(
+              source, flow_->sourceAllocCb, flow_->sourceReadCb);
+          }
+        }
+
+        // the thread pool writes to a duplicate of the socket that the state
+        // owns, the number of the stream's fd may be reused once it closes
+        int dupSendFileSocket() {
+          uv_os_fd_t fd;
+          int err;
+          if ((err = uv_fileno(
+                reinterpret_cast<uv_handle_t *>(this->get()), &fd)) != 0) {
+            return err;
+          }
+          fileSend_->outFd = ::dup(fd);
+          return fileSend_->outFd != -1 ? 0 : -errno;
+        }
+
+        void sendFileChunk() {
+          auto fs = fileSend_.get();
+          int err;
+          auto remaining = fs->length - fs->sent;
+          auto chunk = remaining < UVCPP_SENDFILE_CHUNK_SIZE ?
+            remaining : UVCPP_SENDFILE_CHUNK_SIZE;
+          if ((err = uv_fs_sendfile(
+                this->get()->loop, &fs->req, fs->outFd, fs->fd,
+                fs->offset + fs->sent, static_cast<std::size_t>(chunk),
+                onSendFileCallback)) != 0) {
+            finishSendFile(err);
+            return;
+          }
+          fs->inFlight = true;
+        }
+
+        static void onSendFileCallback(uv_fs_t *req) {
+          auto fs = reinterpret_cast<FileSendState *>(req->data);
+          auto result = req->result;
+          uv_fs_req_cleanup(req);
+          fs->inFlight = false;
+
+          auto st = fs->stream;
+          if (!st) {
+            delete fs;
+            return;
+          }
+          if (!st->isValid()) {
+            st->finishSendFile(UV_ECANCELED);
+            return;
+          }
+
+          if (result > 0) {
+            st->touchWrite();
+            fs->sent += result;
+            st->template publish<EvSendFileProgress>(
+              EvSendFileProgress{ fs->sent, fs->length });
+            if (fs->sent == fs->length) {
+              st->finishSendFile(0);
+            } else if (fs->active) {
+              st->sendFileChunk();
             }
+          } else if (result == UV_EAGAIN) {
+            st->waitSendFileWritable();
+          } else {
+            st->finishSendFile(result == 0 ? UV_EOF : result);
+          }
+        }
+
+        // polls a duplicate of the descriptor, libuv allows one watcher per
+        // descriptor, the poll keeps itself alive until it is closed
+        void waitSendFileWritable() {
+          auto fs = fileSend_.get();
+          if (!fs->poll) {
+            uv_os_fd_t fd;
+            uv_fileno(reinterpret_cast<uv_handle_t *>(this->get()), &fd);
+            auto pollFd = dup(fd);
+            if (pollFd == -1) {
+              finishSendFile(UV_EBADF);
+              return;
+            }
+            auto poll = Poll::createShared(this->getLoop());
+            if (!poll->initWithFd(pollFd)) {
+              ::close(pollFd);
+              finishSendFile(UV_EBADF);
+              return;
+            }
+
+            poll->template sharedRefUntil<EvClose>();
+            poll->template on<EvClose>([pollFd](const auto &e, auto &p) {
+              ::close(pollFd);
+            });
+            poll->template on<EvPoll>([this](const auto &e, auto &p) {
+              p.stop();
+              this->sendFileChunk();
+            });
+            poll->template on<EvError>([this](const auto &e, auto &p) {
+              this->finishSendFile(e.status);
+            });
+            fs->poll = std::move(poll);
+          }
+          fs->poll->poll(Poll::WRITABLE);
+        }
+
+        void finishSendFile(int status) {
+          auto fs = fileSend_.get();
+          if (!fs->active) {
+            return;
+          }
+          fs->active = false;
+          fs->waitingWrites = false;
+          fs->closeOutFd();
+          if (fs->poll) {
+            fs->poll->close();
+            fs->poll.reset();
+          }
+
+          this->template publish<EvSendFile>(EvSendFile{ status, fs->sent });
+          if (status < 0) {
+            this->reportError("sendfile", status);
+            return;
+          }
+
+          if (!cork_ || !cork_->corked) {
+            flushCorked();
+          }
+          if (fs->shutdownAfter) {
+            fs->shutdownAfter = false;
+            shutdown();
+          }
+        }
+
+        /**
+         * drops the settings an open stream got from its current user, for
+         * connections handed from one user to the next: the timeouts, the
+         * watermarks and the flow source, cork, the handler and the read
+         * buffers. gathered buffers are sent, reading has to be stopped.
+         */
+        void resetSettings() {
+          if (cork_) {
+            cork_->autoCork = false;
+            uncork();
+          }
+          if (flow_) {
+            resumeFlowSource();
+            flow_.reset();
+          }
+          if (timeouts_) {
+            timeouts_->entry.cancel();
+            timeouts_.reset();
+          }
+          if (ownedReadBuf_) {
+            ownedReadPool_->recycle(std::move(ownedReadBuf_));
+          }
+          ownedReadPool_.reset();
+          readBufferPolicy_.reset();
+          readHandler_ = nullptr;
+          allowHalfOpen_ = false;
+        }
+
+        /**
+         * drops the subscriptions and settings of a closed stream, so that
+         * it can be initialized again, the read buffer is kept. false if a
+         * request in flight still refers to it.
+         */
+        bool resetForReuse() {
+          if (fileSend_ && fileSend_->inFlight) {
+            return false;
+          }
+          this->clearCallbacks();
+          allowHalfOpen_ = false;
+          readHandler_ = nullptr;
+          readBufferPolicy_.reset();
+          ownedReadPool_.reset();
+          ownedReadBuf_.reset();
+          cork_.reset();
+          flow_.reset();
+          fileSend_.reset();
+          timeouts_.reset();
+          return true;
+        }
+
+        void recycleBuffers(WriteReq &req) {
+          req.forEachBuffer([this](auto buffer) {
+            this->template publish<EvBufferRecycled>(
+              EvBufferRecycled{ std::move(buffer) });
           });
+        }
+
+        bool doWritevAsync(BufferVector buffers) {
+          if (!this->isValid() || buffers.empty()) {
+            return false;
+          }
+
+          // libuv copies the uv_buf_t array into the request
+          const std::size_t kInlineBufs = 8;
+          uv_buf_t inlineBufs[kInlineBufs];
+          std::unique_ptr<uv_buf_t[]> heapBufs{nullptr};
+          auto bufs = inlineBufs;
+          auto nbufs = buffers.size();
+          if (nbufs > kInlineBufs) {
+            heapBufs.reset(new uv_buf_t[nbufs]);
+            bufs = heapBufs.get();
+          }
+          for (std::size_t i = 0; i < nbufs; ++i) {
+            bufs[i] = uv_buf_init(
+              buffers[i]->getData(),
+              static_cast<unsigned int>(buffers[i]->getLength()));
+          }
+
+          auto req = ReqPool<WriteReq>::of(this->get()->loop).acquire();
+          req->buffers = std::make_unique<BufferVector>(std::move(buffers));
+          auto rawReq = req->get();
+          pendingReqs_.push(std::move(req));
+
+          int err;
+          if ((err = uv_write(
+                rawReq,
+                reinterpret_cast<uv_stream_t *>(this->get()),
+                bufs, static_cast<unsigned int>(nbufs),
+                onWriteCallback)) != 0) {
+            this->reportError("uv_write", err);
+            return false;
+          }
+          checkWriteBlocked();
           return true;
         }
 
-      protected:
-        virtual void doAccept() = 0;
 
         bool sendHandle(uv_stream_t *handle) {
           auto currentHandleType = this->get()->type;
@@ -154,9 +919,10 @@ namespace uvcpp {
           auto buffer = std::make_unique<nul::Buffer>(1);
           buffer->setLength(1);
           auto rawBuffer = buffer->asPod();
-          auto req = WriteReq::createUnique(this->getLoop(), std::move(buffer));
+          auto req = ReqPool<WriteReq>::of(this->get()->loop).acquire();
+          req->buffer = std::move(buffer);
           auto rawReq = req->get();
-          pendingReqs_.push_back(std::move(req));
+          pendingReqs_.push(std::move(req));
 
           int err;
           if ((err = uv_write2(
@@ -170,48 +936,157 @@ namespace uvcpp {
           return true;
         }
 
+        ReadBufferPolicy *getActiveReadBufferPolicy() {
+          return readBufferPolicy_ ?
+            readBufferPolicy_.get() :
+            Loop::fromRaw(this->get()->loop)->getReadBufferPolicy();
+        }
+
+        void releaseReadBuffer(const uv_buf_t *buf, ssize_t nread) {
+          if (auto policy = getActiveReadBufferPolicy()) {
+            policy->release(
+              reinterpret_cast<uv_handle_t *>(this->get()), buf, nread);
+          }
+        }
+
         static void onAllocCallback(
           uv_handle_t *handle, std::size_t size, uv_buf_t *buf) {
           auto st = reinterpret_cast<Stream *>(handle->data);
+          if (auto policy = st->getActiveReadBufferPolicy()) {
+            policy->allocate(handle, size, buf);
+            return;
+          }
+
+#if defined(UVCPP_LOOP_READ_BUFFER)
+          auto loop = Loop::fromRaw(handle->loop);
+          buf->base = loop->getReadBuffer();
+          buf->len = loop->getReadBufferSize();
+#elif defined(UVCPP_COMPACT_HANDLES)
+          if (!st->readBuf_) {
+            st->readBuf_.reset(new char[UVCPP_STREAM_BUF_SIZE]);
+          }
+          buf->base = st->readBuf_.get();
+          buf->len = UVCPP_STREAM_BUF_SIZE;
+#else
           buf->base = st->readBuf_;
-          buf->len = sizeof(st->readBuf_);
+          buf->len = UVCPP_STREAM_BUF_SIZE;
+#endif
         }
 
+        // nread == 0 is EAGAIN || EWOULDBLOCK, the buffer is released
+        // on every path, it may come from a policy
         static void onReadCallback(
           uv_stream_t *handle, ssize_t nread, const uv_buf_t *buf) {
-          if (nread == 0) { // EAGAIN || EWOULDBLOCK
-            return;
+          auto st = reinterpret_cast<Stream *>(handle->data);
+          if (nread > 0) {
+            st->touchRead();
+            st->template publish<EvRead>(EvRead{ buf->base, nread });
+          }
+
+          st->releaseReadBuffer(buf, nread);
+          if (nread < 0) {
+            st->onReadError(nread);
           }
+        }
 
+        template <typename Handler>
+        static void onStaticReadCallback(
+          uv_stream_t *handle, ssize_t nread, const uv_buf_t *buf) {
           auto st = reinterpret_cast<Stream *>(handle->data);
+          if (nread > 0) {
+            st->touchRead();
+            static_cast<Handler *>(st->readHandler_)->onRead(buf->base, nread);
+          }
+
+          st->releaseReadBuffer(buf, nread);
           if (nread < 0) {
-            if (nread != UV_EOF) {
-              LOG_E("TCP read failed: %s", uv_strerror(nread));
+            st->onReadError(nread);
+          }
+        }
+
+        static void onOwnedAllocCallback(
+          uv_handle_t *handle, std::size_t size, uv_buf_t *buf) {
+          auto st = reinterpret_cast<Stream *>(handle->data);
+          // kept across EAGAIN and failed reads
+          if (!st->ownedReadBuf_) {
+            st->ownedReadBuf_ = st->ownedReadPool_->take();
+          }
+          buf->base = st->ownedReadBuf_->getData();
+          buf->len = st->ownedReadBuf_->getCapacity();
+        }
+
+        static void onOwnedReadCallback(
+          uv_stream_t *handle, ssize_t nread, const uv_buf_t *buf) {
+          auto st = reinterpret_cast<Stream *>(handle->data);
+          if (nread > 0) {
+            st->touchRead();
+            st->ownedReadBuf_->setLength(nread);
+            auto event = EvReadOwned{ std::move(st->ownedReadBuf_) };
+            // published by reference, the event still owns the buffer
+            // unless a callback moved it out
+            st->template publish<EvReadOwned>(std::move(event));
+            if (event.buffer) {
+              st->ownedReadPool_->recycle(std::move(event.buffer));
             }
-            st->close();
-            return;
+          } else if (nread < 0) {
+            st->onReadError(nread);
           }
+        }
 
-          st->template publish<EvRead>(EvRead{ buf->base, nread });
+        void onReadError(ssize_t nread) {
+          if (nread == UV_EOF && allowHalfOpen_) {
+            uv_read_stop(reinterpret_cast<uv_stream_t *>(this->get()));
+            setReading(false);
+            this->template publish<EvEnd>(EvEnd{});
+            return;
+          }
+          if (nread != UV_EOF) {
+            LOG_E("TCP read failed: %s", uv_strerror(nread));
+          }
+          this->close();
         }
 
         static void onWriteCallback(uv_write_t *req, int status) {
           auto st = reinterpret_cast<Stream *>(req->handle->data);
-          if (!st->pendingReqs_.empty()) {
-            auto req = std::move(st->pendingReqs_.front());
-            st->pendingReqs_.pop_front();
-
-            // req->buffer may be std::moved() in EvError callback
-            if (req->buffer) {
-              st->template publish<EvBufferRecycled>(
-                EvBufferRecycled{ std::move(req->buffer) });
-            }
+          // req->buffer may be std::moved() in EvError callback
+          if (auto writeReq = st->pendingReqs_.pop()) {
+            st->recycleBuffers(*writeReq);
+            ReqPool<WriteReq>::of(req->handle->loop).recycle(std::move(writeReq));
           }
 
           if (status < 0) {
             st->reportError("write", status);
           } else {
+            st->touchWrite();
             st->template publish<EvWrite>(EvWrite{});
+            st->checkWritable();
+            st->sendFileAfterWrites();
+          }
+        }
+
+        void sendFileAfterWrites() {
+          if (fileSend_ && fileSend_->waitingWrites && pendingReqs_.empty()) {
+            fileSend_->waitingWrites = false;
+            sendFileChunk();
+          }
+        }
+
+        template <typename Handler>
+        static void onStaticWriteCallback(uv_write_t *req, int status) {
+          auto st = reinterpret_cast<Stream *>(req->handle->data);
+          // writes complete in order, req is the earliest pending one
+          auto writeReq = st->pendingReqs_.pop();
+          auto handler = static_cast<Handler *>(writeReq->handler);
+          auto buffer = std::move(writeReq->buffer);
+          ReqPool<WriteReq>::of(req->handle->loop).recycle(std::move(writeReq));
+          handler->onWrite(std::move(buffer), status);
+
+          if (status < 0) {
+            st->reportError("write", status);
+          } else {
+            st->touchWrite();
+            st->checkWritable();
+            st->sendFileAfterWrites();
           }
         }
 
@@ -226,18 +1101,200 @@ namespace uvcpp {
         }
 
         static void onShutdownCallback(uv_shutdown_t *r, int status) {
-          auto req = reinterpret_cast<Stream *>(r->handle->data);
-          req->template publish<EvShutdown>(EvShutdown{});
+          auto st = reinterpret_cast<Stream *>(r->handle->data);
+          std::unique_ptr<ShutdownReq> req{static_cast<ShutdownReq *>(
+            reinterpret_cast<LiteReq<uv_shutdown_t> *>(r->data))};
+          ReqPool<ShutdownReq>::of(r->handle->loop).recycle(std::move(req));
+          st->template publish<EvShutdown>(EvShutdown{});
         }
 
       private:
-        std::deque<std::unique_ptr<WriteReq>> pendingReqs_{};
-        std::unique_ptr<ShutdownReq> shutdownReq_{nullptr};
+        // allocated on the first cork() or setAutoCork(true)
+        struct CorkState : public PrePollTask {
+          CorkState(Stream *stream) :
+            PrePollTask(onCorkFlush), stream(stream) { }
 
-#ifdef UVCPP_STREAM_BUF_SIZE
-        char readBuf_[UVCPP_STREAM_BUF_SIZE];
+          Stream *stream;
+          BufferVector buffers;
+          bool corked{false};
+          bool autoCork{false};
+        };
+
+        // allocated on the first setWriteWatermarks() or setFlowSource()
+        struct FlowState {
+          std::size_t high{0};
+          std::size_t low{0};
+          uv_stream_t *source{nullptr};
+          uv_alloc_cb sourceAllocCb{nullptr};
+          uv_read_cb sourceReadCb{nullptr};
+          bool blocked{false};
+          bool sourcePaused{false};
+        };
+
+        // allocated on the first sendFile()
+        struct FileSendState {
+          FileSendState(Stream *stream) : stream(stream) {
+            req.data = this;
+          }
+
+          ~FileSendState() {
+            closeOutFd();
+          }
+
+          void closeOutFd() {
+            if (outFd != -1) {
+              ::close(outFd);
+              outFd = -1;
+            }
+          }
+
+          Stream *stream;
+          uv_fs_t req;
+          uv_file fd{-1};
+          // duplicate of the socket, see dupSendFileSocket()
+          uv_os_fd_t outFd{-1};
+          std::int64_t offset{0};
+          std::uint64_t length{0};
+          std::uint64_t sent{0};
+          std::shared_ptr<Poll> poll{nullptr};
+          bool active{false};
+          bool inFlight{false};
+          bool waitingWrites{false};
+          bool shutdownAfter{false};
+        };
+
+        // allocated on the first setConnectTimeout(), setIdleTimeout() or
+        // setReadTimeout(), the deadlines are pushed back lazily, the
+        // entry is rescheduled only when it fires early
+        struct TimeoutState {
+          TimeoutState(Stream *stream) : entry(onTimeout, stream) { }
+
+          TimerWheelEntry entry;
+          std::uint64_t connectTimeout{0};
+          std::uint64_t idleTimeout{0};
+          std::uint64_t readTimeout{0};
+          std::uint64_t connectStart{0};
+          std::uint64_t lastActivity{0};
+          std::uint64_t lastRead{0};
+          bool connecting{false};
+          bool reading{false};
+        };
+
+        TimeoutState *getTimeoutState() {
+          if (!timeouts_) {
+            timeouts_ = std::make_unique<TimeoutState>(this);
+          }
+          return timeouts_.get();
+        }
+
+        void setReading(bool reading) {
+          if (timeouts_ && timeouts_->reading != reading) {
+            timeouts_->reading = reading;
+            timeouts_->lastRead = uv_now(this->get()->loop);
+            armTimeout();
+          }
+        }
+
+        void touchRead() {
+          if (timeouts_) {
+            timeouts_->lastRead = uv_now(this->get()->loop);
+            timeouts_->lastActivity = timeouts_->lastRead;
+          }
+        }
+
+        void touchWrite() {
+          if (timeouts_) {
+            timeouts_->lastActivity = uv_now(this->get()->loop);
+          }
+        }
+
+        // the earliest deadline, max if none applies
+        std::uint64_t getDeadline(EvTimeout::Type *type) const {
+          auto ts = timeouts_.get();
+          auto deadline = std::numeric_limits<std::uint64_t>::max();
+          if (ts->connecting) {
+            if (ts->connectTimeout > 0) {
+              deadline = ts->connectStart + ts->connectTimeout;
+              *type = EvTimeout::Type::CONNECT;
+            }
+            return deadline;
+          }
+          if (ts->idleTimeout > 0) {
+            deadline = ts->lastActivity + ts->idleTimeout;
+            *type = EvTimeout::Type::IDLE;
+          }
+          if (ts->reading && ts->readTimeout > 0 &&
+              ts->lastRead + ts->readTimeout < deadline) {
+            deadline = ts->lastRead + ts->readTimeout;
+            *type = EvTimeout::Type::READ;
+          }
+          return deadline;
+        }
+
+        void armTimeout() {
+          EvTimeout::Type type;
+          auto deadline = getDeadline(&type);
+          if (deadline == std::numeric_limits<std::uint64_t>::max() ||
+              !this->isValid()) {
+            timeouts_->entry.cancel();
+            return;
+          }
+          auto loop = this->get()->loop;
+          auto now = uv_now(loop);
+          TimerWheel::of(*Loop::fromRaw(loop)).schedule(
+            timeouts_->entry, deadline > now ? deadline - now : 0);
+        }
+
+        static void onTimeout(TimerWheelEntry *entry) {
+          auto st = static_cast<Stream *>(entry->getData());
+          EvTimeout::Type type;
+          auto deadline = st->getDeadline(&type);
+          if (deadline > uv_now(st->get()->loop)) {
+            // pushed back by reads or writes since it was scheduled
+            st->armTimeout();
+            return;
+          }
+          st->template publish<EvTimeout>(EvTimeout{ type });
+          st->close();
+        }
+
+        FlowState *getFlowState() {
+          if (!flow_) {
+            flow_ = std::make_unique<FlowState>();
+          }
+          return flow_.get();
+        }
+
+        CorkState *getCorkState() {
+          if (!cork_) {
+            cork_ = std::make_unique<CorkState>(this);
+          }
+          return cork_.get();
+        }
+
+        static void onCorkFlush(PrePollTask *task) {
+          static_cast<CorkState *>(task)->stream->flushCorked();
+        }
+
+      private:
+        // first, so that it can share the tail padding of Handle
+        bool allowHalfOpen_{false};
+        ReqQueue<WriteReq> pendingReqs_{};
+        void *readHandler_{nullptr};
+        std::shared_ptr<ReadBufferPolicy> readBufferPolicy_{nullptr};
+        std::shared_ptr<BufferPool> ownedReadPool_{nullptr};
+        std::unique_ptr<nul::Buffer> ownedReadBuf_{nullptr};
+        std::unique_ptr<CorkState> cork_{nullptr};
+        std::unique_ptr<FlowState> flow_{nullptr};
+        std::unique_ptr<FileSendState> fileSend_{nullptr};
+        std::unique_ptr<TimeoutState> timeouts_{nullptr};
+
+#if defined(UVCPP_LOOP_READ_BUFFER)
+        // reads go to the scratch buffer of the loop
+#elif defined(UVCPP_COMPACT_HANDLES)
+        std::unique_ptr<char[]> readBuf_{nullptr};
 #else
-        char readBuf_[4096];
+        char readBuf_[UVCPP_STREAM_BUF_SIZE];
 #endif
     };
 
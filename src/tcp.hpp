@@ -1,13 +1,198 @@
 #ifndef UVCPP_TCP_H_
 #define UVCPP_TCP_H_
 #include "stream.hpp"
+#include "poll.hpp"
+#include <cerrno>
+#include <typeinfo>
+#include <unordered_set>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+// number of closed Tcp kept per loop for pooled accepts
+#ifndef UVCPP_TCP_POOL_SIZE
+#define UVCPP_TCP_POOL_SIZE 256
+#endif
+
+// default interval of the periodic TCP_INFO sampling, in milliseconds
+#ifndef UVCPP_TCP_INFO_INTERVAL
+#define UVCPP_TCP_INFO_INTERVAL 1000
+#endif
 
 namespace uvcpp {
+  class Tcp;
+
+  template <>
+  struct EventTraits<Tcp> {
+    using Events = EventList<
+      EvRead, EvReadOwned, EvWrite, EvBufferRecycled, EvConnect,
+      EvShutdown, EvAccept<Tcp>, EvClose, EvError, EvDestroy>;
+  };
+
+  /**
+   * the part of TCP_INFO that matters for tuning, times are in
+   * microseconds, fields the kernel does not report are 0
+   */
+  struct TcpInfo {
+    uint8_t state;
+    uint8_t caState;
+    uint32_t rtt;
+    uint32_t rttVar;
+    uint32_t minRtt;
+    // in segments of mss bytes
+    uint32_t cwnd;
+    uint32_t ssthresh;
+    uint32_t mss;
+    uint32_t unacked;
+    uint32_t lost;
+    uint32_t retrans;
+    uint32_t totalRetrans;
+    uint32_t notSentBytes;
+    // in bytes per second
+    uint64_t deliveryRate;
+    uint64_t pacingRate;
+    uint64_t bytesAcked;
+    uint64_t bytesReceived;
+  };
+
+  struct EvTcpInfo : public Event {
+    EvTcpInfo(const TcpInfo &info) : info(info) { }
+    TcpInfo info;
+  };
+
   class Tcp : public Stream<uv_tcp_t, Tcp> {
     // in Pipe class, sas_ may be accessed when a Tcp handle is accepted there
     friend class Pipe;
+    // resets the subscriptions of the connections it pools
+    friend class TcpConnectionPool;
+    // moves the socket of the winning attempt in
+    friend class HappyEyeballs;
+
+    // closed Tcp handed back with recycle(), they do not own the loop
+    struct AcceptPool : public LoopContext {
+      explicit AcceptPool(Loop &loop) { }
+      std::vector<std::unique_ptr<Tcp>> free;
+    };
+
+    /**
+     * samples TCP_INFO of the Tcp that enabled it on one timer per loop,
+     * the timer does not keep the loop running
+     */
+    struct InfoSampler : public LoopContext {
+      explicit InfoSampler(Loop &loop) : loop(loop) { }
+
+      void closeHandles() override {
+        if (timerInitialized) {
+          loop.closeHandle(reinterpret_cast<uv_handle_t *>(&timer));
+        }
+      }
+
+      void add(Tcp *tcp) {
+        members.insert(tcp);
+        if (!timerInitialized) {
+          if (uv_timer_init(loop.getRaw(), &timer) != 0) {
+            return;
+          }
+          timer.data = this;
+          uv_unref(reinterpret_cast<uv_handle_t *>(&timer));
+          timerInitialized = true;
+        }
+        if (!uv_is_active(reinterpret_cast<uv_handle_t *>(&timer))) {
+          uv_timer_start(&timer, onTimerCallback, interval, interval);
+        }
+      }
+
+      void remove(Tcp *tcp) {
+        members.erase(tcp);
+        if (members.empty() && timerInitialized) {
+          uv_timer_stop(&timer);
+        }
+      }
+
+      void setInterval(uint64_t ms) {
+        interval = ms > 0 ? ms : 1;
+        if (timerInitialized &&
+            uv_is_active(reinterpret_cast<uv_handle_t *>(&timer))) {
+          uv_timer_start(&timer, onTimerCallback, interval, interval);
+        }
+      }
+
+      static void onTimerCallback(uv_timer_t *t) {
+        auto sampler = reinterpret_cast<InfoSampler *>(t->data);
+        // callbacks may disable sampling of any of them
+        auto &batch = sampler->batch;
+        batch.assign(sampler->members.begin(), sampler->members.end());
+        for (auto tcp : batch) {
+          if (sampler->members.count(tcp)) {
+            tcp->sampleTcpInfo();
+          }
+        }
+        batch.clear();
+      }
+
+      Loop &loop;
+      std::unordered_set<Tcp *> members;
+      std::vector<Tcp *> batch;
+      uv_timer_t timer;
+      uint64_t interval{UVCPP_TCP_INFO_INTERVAL};
+      bool timerInitialized{false};
+    };
+
+#if defined(__linux__) && defined(TCP_INFO)
+    // struct tcp_info of linux/tcp.h up to tcpi_delivery_rate, the one of
+    // netinet/tcp.h stops at tcpi_total_retrans
+    struct KernelTcpInfo {
+      uint8_t state;
+      uint8_t caState;
+      uint8_t flags[6];
+      uint32_t rto;
+      uint32_t ato;
+      uint32_t sndMss;
+      uint32_t rcvMss;
+      uint32_t unacked;
+      uint32_t sacked;
+      uint32_t lost;
+      uint32_t retrans;
+      uint32_t fackets;
+      uint32_t lastTimes[4];
+      uint32_t pmtu;
+      uint32_t rcvSsthresh;
+      uint32_t rtt;
+      uint32_t rttVar;
+      uint32_t sndSsthresh;
+      uint32_t sndCwnd;
+      uint32_t advmss;
+      uint32_t reordering;
+      uint32_t rcvRtt;
+      uint32_t rcvSpace;
+      uint32_t totalRetrans;
+      uint64_t pacingRate;
+      uint64_t maxPacingRate;
+      uint64_t bytesAcked;
+      uint64_t bytesReceived;
+      uint32_t segsOut;
+      uint32_t segsIn;
+      uint32_t notSentBytes;
+      uint32_t minRtt;
+      uint32_t dataSegsIn;
+      uint32_t dataSegsOut;
+      uint64_t deliveryRate;
+    };
+#endif
+
+    // state of listenBatched(), only listeners pay for it
+    struct BatchAccept {
+      std::shared_ptr<Poll> poll;
+      std::function<bool(const SockAddr *peer)> admission;
+      std::size_t maxPerIteration;
+      // duplicate of the listener's fd, closed with the poll
+      int fd;
+    };
 
     public:
+      // decides from the peer address whether a connection is accepted
+      using AdmissionFn = std::function<bool(const SockAddr *peer)>;
+
       enum class Domain {
         UNSPEC = AF_UNSPEC,
         INET = AF_INET,
@@ -17,6 +202,10 @@ namespace uvcpp {
       Tcp(const std::shared_ptr<Loop> &loop, Domain domain = Domain::UNSPEC) :
         Stream(loop), domain_(domain) { }
 
+      virtual ~Tcp() {
+        setTcpInfoSampling(false);
+      }
+
       virtual bool init() override {
         auto rawLoop = this->getLoop()->getRaw();
         int err = 0;
@@ -76,9 +265,11 @@ namespace uvcpp {
               connectReq_->get(), get(), sa, onConnect)) != 0) {
           LOG_W("failed to connect to %s:%d, reason: %s",
                 getIP().c_str(), getPort(), uv_strerror(err));
+          return false;
         }
 
-        return err == 0;
+        startConnectTimeout();
+        return true;
       }
 
       bool connect(const std::string &ip, uint16_t port) {
@@ -91,9 +282,10 @@ namespace uvcpp {
         }
       }
 
-      void setKeepAlive(bool enable) {
+      // delay is the idle time in seconds before the first probe
+      void setKeepAlive(bool enable, unsigned int delay = 60) {
         int err;
-        if ((err = uv_tcp_keepalive(get(), enable ? 1 : 0, 60)) != 0) {
+        if ((err = uv_tcp_keepalive(get(), enable ? 1 : 0, delay)) != 0) {
           this->reportError("uv_tcp_keepalive", err);
         }
       }
@@ -111,29 +303,312 @@ namespace uvcpp {
               &fd) == UV_EBADF) {
           LOG_W("uv_fileno failed on server_tcp");
         } else {
-          int err;
-          if ((err = setsockopt(
-                fd, SOL_SOCKET, option, value, optionLength)) == -1) {
-            this->reportError("setsockopt", err);
+          if (setsockopt(fd, SOL_SOCKET, option, value, optionLength) == -1) {
+            this->reportError("setsockopt", -errno);
           }
         }
       }
 
+      /**
+       * unlike setSockOption(option, ...) these do not close the handle on
+       * failure, they log and return false, options are hints the kernel
+       * may not support. the socket must exist, a Tcp of Domain::UNSPEC
+       * has one only after bind(), connect() or accept.
+       */
+      bool setSockOption(
+        int level, int option, const void *value, socklen_t optionLength) {
+        uv_os_fd_t fd;
+        if (uv_fileno(reinterpret_cast<uv_handle_t *>(get()), &fd) != 0) {
+          LOG_W("setsockopt(%d, %d): the Tcp has no socket", level, option);
+          return false;
+        }
+        if (setsockopt(fd, level, option, value, optionLength) == -1) {
+          LOG_W("setsockopt(%d, %d) failed: %s",
+                level, option, strerror(errno));
+          return false;
+        }
+        return true;
+      }
+
+      bool getSockOption(
+        int level, int option, void *value, socklen_t *optionLength) {
+        uv_os_fd_t fd;
+        if (uv_fileno(reinterpret_cast<uv_handle_t *>(get()), &fd) != 0) {
+          return false;
+        }
+        return getsockopt(fd, level, option, value, optionLength) == 0;
+      }
+
+      // TCP_FASTOPEN, on a listener before listen(), queueLength 0 disables
+      bool setFastOpen(int queueLength) {
+#if defined(TCP_FASTOPEN)
+        return setIntOption(IPPROTO_TCP, TCP_FASTOPEN, queueLength);
+#else
+        return unsupported("TCP_FASTOPEN");
+#endif
+      }
+
+      /**
+       * TCP_FASTOPEN_CONNECT, before connect(), so the Tcp must be created
+       * with Domain::INET or INET6. connect() completes right away and the
+       * first write goes out with the SYN, with a cookie from an earlier
+       * connection to the server
+       */
+      bool setFastOpenConnect(bool enable) {
+#if defined(TCP_FASTOPEN_CONNECT)
+        return setIntOption(IPPROTO_TCP, TCP_FASTOPEN_CONNECT, enable);
+#else
+        return unsupported("TCP_FASTOPEN_CONNECT");
+#endif
+      }
+
+      /**
+       * TCP_NOTSENT_LOWAT, the socket is writable only while fewer than
+       * bytes are queued unsent, which keeps the data queued in the kernel
+       * short and lets the latest data win
+       */
+      bool setNotSentLowat(uint32_t bytes) {
+#if defined(TCP_NOTSENT_LOWAT)
+        return setIntOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes);
+#else
+        return unsupported("TCP_NOTSENT_LOWAT");
+#endif
+      }
+
+      // TCP_QUICKACK, the kernel may turn it off again, set it after reads
+      bool setQuickAck(bool enable) {
+#if defined(TCP_QUICKACK)
+        return setIntOption(IPPROTO_TCP, TCP_QUICKACK, enable);
+#else
+        return unsupported("TCP_QUICKACK");
+#endif
+      }
+
+      // TCP_USER_TIMEOUT, in milliseconds unacked data may wait, 0 for the
+      // system default
+      bool setUserTimeout(unsigned int timeout) {
+#if defined(TCP_USER_TIMEOUT)
+        return setIntOption(IPPROTO_TCP, TCP_USER_TIMEOUT, timeout);
+#else
+        return unsupported("TCP_USER_TIMEOUT");
+#endif
+      }
+
+      // SO_BUSY_POLL, in microseconds, above the sysctl needs CAP_NET_ADMIN
+      bool setBusyPoll(int usec) {
+#if defined(SO_BUSY_POLL)
+        return setIntOption(SOL_SOCKET, SO_BUSY_POLL, usec);
+#else
+        return unsupported("SO_BUSY_POLL");
+#endif
+      }
+
+      // SO_SNDBUF, Linux doubles the value for its bookkeeping
+      bool setSendBufferSize(int size) {
+        return setIntOption(SOL_SOCKET, SO_SNDBUF, size);
+      }
+
+      // SO_RCVBUF, Linux doubles the value for its bookkeeping
+      bool setRecvBufferSize(int size) {
+        return setIntOption(SOL_SOCKET, SO_RCVBUF, size);
+      }
+
+      // TCP_KEEPINTVL, seconds between keep-alive probes
+      bool setKeepAliveInterval(int interval) {
+#if defined(TCP_KEEPINTVL)
+        return setIntOption(IPPROTO_TCP, TCP_KEEPINTVL, interval);
+#else
+        return unsupported("TCP_KEEPINTVL");
+#endif
+      }
+
+      // TCP_KEEPCNT, unanswered probes before the connection is dropped
+      bool setKeepAliveCount(int count) {
+#if defined(TCP_KEEPCNT)
+        return setIntOption(IPPROTO_TCP, TCP_KEEPCNT, count);
+#else
+        return unsupported("TCP_KEEPCNT");
+#endif
+      }
+
+      /**
+       * reads TCP_INFO of the connection (Linux only), older kernels fill
+       * in less of it
+       */
+      bool getTcpInfo(TcpInfo *info) {
+#if defined(__linux__) && defined(TCP_INFO)
+        KernelTcpInfo ki;
+        memset(&ki, 0, sizeof(ki));
+        socklen_t len = sizeof(ki);
+        if (!getSockOption(IPPROTO_TCP, TCP_INFO, &ki, &len)) {
+          return false;
+        }
+        info->state = ki.state;
+        info->caState = ki.caState;
+        info->rtt = ki.rtt;
+        info->rttVar = ki.rttVar;
+        info->minRtt = ki.minRtt;
+        info->cwnd = ki.sndCwnd;
+        info->ssthresh = ki.sndSsthresh;
+        info->mss = ki.sndMss;
+        info->unacked = ki.unacked;
+        info->lost = ki.lost;
+        info->retrans = ki.retrans;
+        info->totalRetrans = ki.totalRetrans;
+        info->notSentBytes = ki.notSentBytes;
+        info->deliveryRate = ki.deliveryRate;
+        info->pacingRate = ki.pacingRate;
+        info->bytesAcked = ki.bytesAcked;
+        info->bytesReceived = ki.bytesReceived;
+        return true;
+#else
+        return unsupported("TCP_INFO");
+#endif
+      }
+
+      // publishes EvTcpInfo with a sample taken right away
+      bool sampleTcpInfo() {
+        TcpInfo info;
+        if (!getTcpInfo(&info)) {
+          return false;
+        }
+        publish<EvTcpInfo>(EvTcpInfo{ info });
+        return true;
+      }
+
+      /**
+       * publishes EvTcpInfo every interval set with setTcpInfoInterval()
+       * until disabled or closed, all the Tcp of a loop share one timer
+       */
+      void setTcpInfoSampling(bool enable) {
+        if (enable == sampleInfo_ || (enable && !isValid())) {
+          return;
+        }
+        sampleInfo_ = enable;
+        auto &sampler =
+          Loop::fromRaw(get()->loop)->getContext<InfoSampler>();
+        if (enable) {
+          sampler.add(this);
+        } else {
+          sampler.remove(this);
+        }
+      }
+
+      // in milliseconds, for all the Tcp of the loop
+      static void setTcpInfoInterval(Loop &loop, uint64_t interval) {
+        loop.getContext<InfoSampler>().setInterval(interval);
+      }
+
+      // the peer address of accepted connections is looked up on first use
       const SockAddr *getSockAddr() const {
+        resolvePeer();
         return reinterpret_cast<const SockAddr *>(&sas_);
       }
 
       std::string getIP() const {
-        return NetUtil::ip(reinterpret_cast<const SockAddr *>(&sas_));
+        return NetUtil::ip(getSockAddr());
       }
 
       uint16_t getPort() const {
-        return NetUtil::port(reinterpret_cast<const SockAddr *>(&sas_));
+        return NetUtil::port(getSockAddr());
+      }
+
+      /**
+       * listens without libuv's accept path, each time the listener is
+       * readable up to maxPerIteration connections are taken from the
+       * backlog with accept(2), the rest wait for the next loop iteration.
+       * admission, if any, sees the peer address before anything is
+       * allocated for the connection, rejected connections are closed
+       * right away. the admitted ones are published with EvAccept<Tcp>.
+       */
+      bool listenBatched(
+        int backlog, std::size_t maxPerIteration = 64,
+        AdmissionFn admission = nullptr) {
+        uv_os_fd_t fd;
+        int err;
+        if ((err = uv_fileno(
+              reinterpret_cast<uv_handle_t *>(get()), &fd)) != 0) {
+          this->reportError("uv_fileno", err);
+          return false;
+        }
+        if (::listen(fd, backlog) == -1) {
+          this->reportError("listen", -errno);
+          return false;
+        }
+
+        // the poll watches a duplicate of its own, the number of the
+        // listener's fd may be reused once uv_close() has closed it
+        auto pollFd = ::dup(fd);
+        if (pollFd == -1) {
+          this->reportError("dup", -errno);
+          return false;
+        }
+        auto poll = Poll::createShared(this->getLoop());
+        if (!poll || !poll->initWithFd(pollFd)) {
+          ::close(pollFd);
+          this->reportError("uv_poll_init", UV_EBADF);
+          return false;
+        }
+        poll->sharedRefUntil<EvClose>();
+        poll->on<EvClose>([pollFd](const auto &e, auto &p) {
+          ::close(pollFd);
+        });
+        poll->on<EvPoll>([this](const auto &e, auto &p) {
+          this->drainAccepts();
+        });
+        poll->on<EvError>([this](const auto &e, auto &p) {
+          this->reportError("accept", e.status);
+        });
+
+        batch_ = std::make_unique<BatchAccept>();
+        batch_->poll = std::move(poll);
+        batch_->admission = std::move(admission);
+        batch_->maxPerIteration = maxPerIteration > 0 ? maxPerIteration : 1;
+        batch_->fd = pollFd;
+        batch_->poll->poll(Poll::READABLE);
+        return true;
+      }
+
+      /**
+       * accepted connections are taken from the closed Tcp handed back
+       * with recycle() instead of being allocated, for servers that see
+       * many short-lived connections
+       */
+      void setPooledAccept(bool enable) {
+        pooledAccept_ = enable;
+      }
+
+      /**
+       * hands a closed Tcp, e.g. from its EvClose callback, to the pool of
+       * its loop for pooled accepts, its subscriptions and settings are
+       * dropped and its read buffer is kept, it no longer owns the loop
+       * until it is accepted again. Tcp that are not closed yet,
+       * or are of a derived type, are destroyed instead.
+       */
+      static void recycle(std::unique_ptr<Tcp> tcp) {
+        if (!tcp || tcp->isValid() || typeid(*tcp) != typeid(Tcp) ||
+            !tcp->resetForReuse()) {
+          return;
+        }
+        auto &pool = Loop::fromRaw(tcp->get()->loop)->getContext<AcceptPool>();
+        if (pool.free.size() >= UVCPP_TCP_POOL_SIZE) {
+          return;
+        }
+        tcp->batch_.reset();
+        tcp->connectReq_.reset();
+        tcp->disownLoop();
+        tcp->domain_ = Domain::UNSPEC;
+        tcp->peerPending_ = false;
+        tcp->pooledAccept_ = false;
+        pool.free.push_back(std::move(tcp));
       }
 
     protected:
       virtual void doAccept() override {
-        auto client = Tcp::createUnique(this->getLoop());
+        auto client = pooledAccept_ ? takePooled() : nullptr;
+        if (!client) {
+          client = Tcp::createUnique(this->getLoop());
+        }
         if (!client) {
           return;
         }
@@ -145,23 +620,121 @@ namespace uvcpp {
           return;
         }
 
-        int len = sizeof(client->sas_);
-        if ((err = uv_tcp_getpeername(client->get(),
-              reinterpret_cast<SockAddr *>(&client->sas_), &len)) != 0) {
-          LOG_E("uv_tcp_getpeername failed: %s", uv_strerror(err));
-          std::shared_ptr<Tcp> sharedClient = std::move(client);
-          sharedClient->sharedRefUntil<EvClose>();
-          sharedClient->close();
-          return;
-        }
-
+        client->peerPending_ = true;
+        // compiled out with the address lookup unless LOG_VERBOSE is defined
         LOG_V("client: %s:%d", client->getIP().c_str(), client->getPort());
         publish<EvAccept<Tcp>>(EvAccept<Tcp>{ std::move(client) });
       }
 
+      virtual void onClose() override {
+        Stream::onClose();
+        setTcpInfoSampling(false);
+        if (batch_ && batch_->poll) {
+          batch_->poll->close();
+          batch_->poll.reset();
+        }
+      }
+
     private:
+      void drainAccepts() {
+        for (std::size_t i = 0; i < batch_->maxPerIteration; ++i) {
+          SockAddrStorage sas;
+          socklen_t len = sizeof(sas);
+          auto fd = acceptSocket(
+            batch_->fd, reinterpret_cast<SockAddr *>(&sas), &len);
+          if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+              continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+              LOG_W("accept failed: %s", strerror(errno));
+            }
+            return;
+          }
+
+          auto peer = reinterpret_cast<SockAddr *>(&sas);
+          if (batch_->admission && !batch_->admission(peer)) {
+            ::close(fd);
+            continue;
+          }
+
+          auto client = pooledAccept_ ? takePooled() : nullptr;
+          if (!client) {
+            client = Tcp::createUnique(this->getLoop());
+          }
+          int err;
+          if (!client || (err = uv_tcp_open(client->get(), fd)) != 0) {
+            ::close(fd);
+            if (client) {
+              std::shared_ptr<Tcp> sharedClient = std::move(client);
+              sharedClient->sharedRefUntil<EvClose>();
+              sharedClient->close();
+            }
+            continue;
+          }
+
+          memcpy(&client->sas_, &sas, len);
+          publish<EvAccept<Tcp>>(EvAccept<Tcp>{ std::move(client) });
+          // closed from the callback
+          if (!this->isValid()) {
+            return;
+          }
+        }
+      }
+
+      static int acceptSocket(int fd, SockAddr *sa, socklen_t *len) {
+#if defined(__linux__)
+        return accept4(fd, sa, len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        auto client = accept(fd, sa, len);
+        if (client != -1) {
+          fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+          fcntl(client, F_SETFD, FD_CLOEXEC);
+        }
+        return client;
+#endif
+      }
+
+      std::unique_ptr<Tcp> takePooled() {
+        auto &pool = Loop::fromRaw(get()->loop)->getContext<AcceptPool>();
+        while (!pool.free.empty()) {
+          auto tcp = std::move(pool.free.back());
+          pool.free.pop_back();
+          tcp->adoptLoop(this->getLoop());
+          if (tcp->init()) {
+            return tcp;
+          }
+        }
+        return nullptr;
+      }
+
+      void resolvePeer() const {
+        if (!peerPending_) {
+          return;
+        }
+        peerPending_ = false;
+        int len = sizeof(sas_);
+        int err;
+        if ((err = uv_tcp_getpeername(
+              const_cast<Tcp *>(this)->get(),
+              reinterpret_cast<SockAddr *>(&sas_), &len)) != 0) {
+          LOG_W("uv_tcp_getpeername failed: %s", uv_strerror(err));
+          memset(&sas_, 0, sizeof(sas_));
+        }
+      }
+
+      bool setIntOption(int level, int option, int value) {
+        return setSockOption(level, option, &value, sizeof(value));
+      }
+
+      static bool unsupported(const char *option) {
+        LOG_W("%s is not supported on this platform", option);
+        return false;
+      }
+
       static void onConnect(uv_connect_t *req, int status) {
         auto tcp = reinterpret_cast<Tcp *>(req->handle->data);
+        tcp->stopConnectTimeout();
         if (status < 0) {
           LOG_E("onConnect failed: %s", uv_strerror(status));
           tcp->reportError("uv_tcp_connect", status);
@@ -172,8 +745,13 @@ namespace uvcpp {
 
     private:
       Domain domain_;
+      // in the padding after domain_
+      bool pooledAccept_{false};
+      mutable bool peerPending_{false};
+      bool sampleInfo_{false};
       std::unique_ptr<ConnectReq> connectReq_{nullptr};
-      SockAddrStorage sas_;
+      std::unique_ptr<BatchAccept> batch_{nullptr};
+      mutable SockAddrStorage sas_;
   };
 } /* end of namspace: uvcpp */
 
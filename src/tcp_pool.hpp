@@ -0,0 +1,360 @@
+#ifndef UVCPP_TCP_POOL_H_
+#define UVCPP_TCP_POOL_H_
+#include "tcp.hpp"
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace uvcpp {
+
+  /**
+   * per-loop pool of outbound Tcp connections, keyed by the destination
+   * address. acquire() hands back an idle connection to the destination
+   * if there is one, or dials a new one, or waits for one to be released
+   * once the destination has maxTotal connections. release() takes a
+   * connection back, the subscriptions made while it was leased are
+   * dropped.
+   *
+   * idle connections read, so that data, EOF or an error from the peer
+   * evicts them, and are closed after the idle timeout. the idle and the
+   * connecting ones neither keep the loop running nor own it, they are
+   * closed along with the loop once its last reference is dropped.
+   */
+  class TcpConnectionPool : public LoopContext {
+    enum class State {
+      CONNECTING,
+      IDLE
+    };
+
+    struct Entry {
+      std::unique_ptr<Tcp> tcp;
+      State state;
+      uint64_t idleSince;
+    };
+
+    struct Host {
+      SockAddrStorage addr;
+      std::vector<Entry> entries;
+      std::unordered_set<Tcp *> leased;
+      std::deque<std::function<void(std::unique_ptr<Tcp>, int)>> waiters;
+      std::size_t idleCount{0};
+      std::size_t total{0};
+    };
+
+    public:
+      // tcp is nullptr if status < 0
+      using AcquireCallback =
+        std::function<void(std::unique_ptr<Tcp> tcp, int status)>;
+
+      explicit TcpConnectionPool(Loop &loop) : loop_(loop) { }
+
+      void closeHandles() override {
+        if (timerInitialized_) {
+          loop_.closeHandle(reinterpret_cast<uv_handle_t *>(&timer_));
+        }
+        // the callbacks may refer to what is gone with the loop already
+        for (auto &h : hosts_) {
+          for (auto &e : h.second.entries) {
+            e.tcp->clearCallbacks();
+            loop_.closeHandle(reinterpret_cast<uv_handle_t *>(e.tcp->get()));
+          }
+        }
+      }
+
+      static TcpConnectionPool &of(const std::shared_ptr<Loop> &loop) {
+        auto &pool = loop->getContext<TcpConnectionPool>();
+        // leased Tcp hold the loop, the pool and what it keeps must not
+        pool.sharedLoop_ = loop;
+        return pool;
+      }
+
+      // idle connections kept per destination, 8 by default
+      void setMaxIdle(std::size_t maxIdle) {
+        maxIdle_ = maxIdle;
+      }
+
+      // connections per destination, idle, leased or connecting
+      void setMaxTotal(std::size_t maxTotal) {
+        maxTotal_ = maxTotal > 0 ? maxTotal : 1;
+      }
+
+      // in milliseconds, 30s by default
+      void setIdleTimeout(uint64_t timeout) {
+        idleTimeout_ = timeout > 0 ? timeout : 1;
+      }
+
+      /**
+       * cb is called right away with an idle connection, or once a new
+       * connection is established, or once a connection is released to
+       * the destination at its limit
+       */
+      void acquire(const SockAddr *addr, AcquireCallback cb) {
+        auto &host = getHost(addr);
+        if (host.idleCount > 0) {
+          lease(host, takeIdle(host), std::move(cb));
+        } else if (host.total < maxTotal_) {
+          dial(host, std::move(cb));
+        } else {
+          host.waiters.push_back(std::move(cb));
+        }
+      }
+
+      bool acquire(
+        const std::string &ip, uint16_t port, AcquireCallback cb) {
+        SockAddrStorage sas;
+        if (!NetUtil::convertIPAddress(ip, port, &sas)) {
+          LOG_E("[%s] is not a valid ip address", ip.c_str());
+          return false;
+        }
+        acquire(reinterpret_cast<SockAddr *>(&sas), std::move(cb));
+        return true;
+      }
+
+      /**
+       * takes back a connection from acquire(), it is kept idle if it is
+       * still open, handed to a waiter, or closed if the destination has
+       * maxIdle idle connections already. its subscriptions and the
+       * settings of the lease, see Stream::resetSettings(), are dropped.
+       */
+      void release(std::unique_ptr<Tcp> tcp) {
+        auto &host = getHost(tcp->getSockAddr());
+        if (!host.leased.count(tcp.get())) {
+          // closed while leased, nothing refers to it anymore
+          return;
+        }
+
+        if (!tcp->isValid()) {
+          std::shared_ptr<Tcp> closing = std::move(tcp);
+          closing->sharedRefUntil<EvClose>();
+          return;
+        }
+
+        host.leased.erase(tcp.get());
+        tcp->clearCallbacks();
+        tcp->readStop();
+        // nothing of the lease carries over to the next one
+        tcp->resetSettings();
+        tcp->setTcpInfoSampling(false);
+        if (!host.waiters.empty()) {
+          auto cb = std::move(host.waiters.front());
+          host.waiters.pop_front();
+          lease(host, std::move(tcp), std::move(cb));
+        } else if (host.idleCount < maxIdle_) {
+          keepIdle(host, std::move(tcp));
+        } else {
+          --host.total;
+          std::shared_ptr<Tcp> closing = std::move(tcp);
+          closing->sharedRefUntil<EvClose>();
+          closing->close();
+        }
+      }
+
+      // closes the idle connections
+      void clear() {
+        for (auto &h : hosts_) {
+          for (auto &e : h.second.entries) {
+            if (e.state == State::IDLE) {
+              e.tcp->close();
+            }
+          }
+        }
+      }
+
+      std::size_t getIdleCount(const SockAddr *addr) {
+        return getHost(addr).idleCount;
+      }
+
+      std::size_t getTotalCount(const SockAddr *addr) {
+        return getHost(addr).total;
+      }
+
+    private:
+      static std::string makeKey(const SockAddr *addr) {
+        if (addr->sa_family == AF_INET6) {
+          auto sa6 = reinterpret_cast<const SockAddr6 *>(addr);
+          std::string key(1, '6');
+          key.append(reinterpret_cast<const char *>(&sa6->sin6_port), 2);
+          key.append(reinterpret_cast<const char *>(&sa6->sin6_addr), 16);
+          return key;
+        }
+        auto sa4 = reinterpret_cast<const SockAddr4 *>(addr);
+        std::string key(1, '4');
+        key.append(reinterpret_cast<const char *>(&sa4->sin_port), 2);
+        key.append(reinterpret_cast<const char *>(&sa4->sin_addr), 4);
+        return key;
+      }
+
+      Host &getHost(const SockAddr *addr) {
+        auto result = hosts_.emplace(makeKey(addr), Host{});
+        auto &host = result.first->second;
+        if (result.second) {
+          memcpy(&host.addr, addr, addr->sa_family == AF_INET6 ?
+                 sizeof(SockAddr6) : sizeof(SockAddr4));
+        }
+        return host;
+      }
+
+      // the entry may be of the connection whose callback is running
+      std::unique_ptr<Tcp> removeEntry(Host &host, Tcp *tcp) {
+        auto it = std::find_if(
+          host.entries.begin(), host.entries.end(),
+          [tcp](const Entry &e) { return e.tcp.get() == tcp; });
+        if (it == host.entries.end()) {
+          return nullptr;
+        }
+        if (it->state == State::IDLE) {
+          --host.idleCount;
+        }
+        auto owned = std::move(it->tcp);
+        host.entries.erase(it);
+        return owned;
+      }
+
+      void dial(Host &host, AcquireCallback cb) {
+        auto loop = sharedLoop_.lock();
+        auto tcp = loop ? Tcp::createUnique(loop) : nullptr;
+        if (!tcp) {
+          cb(nullptr, UV_ENOMEM);
+          return;
+        }
+
+        // the pool holds it, so it must not hold the loop, the connect
+        // request it creates does not either
+        tcp->disownLoop();
+        auto hostPtr = &host;
+        auto callback = std::make_shared<AcquireCallback>(std::move(cb));
+        tcp->on<EvConnect>(
+          [this, hostPtr, callback](const auto &e, auto &t) {
+            auto tcp = this->removeEntry(*hostPtr, &t);
+            this->lease(*hostPtr, std::move(tcp), std::move(*callback));
+          });
+        // errors close the connection
+        tcp->on<EvError>([callback](const auto &e, auto &t) {
+          (*callback)(nullptr, e.status);
+        });
+        tcp->on<EvClose>([this, hostPtr](const auto &e, auto &t) {
+          this->onClosed(*hostPtr, &t);
+        });
+
+        ++host.total;
+        if (!tcp->connect(reinterpret_cast<SockAddr *>(&host.addr))) {
+          std::shared_ptr<Tcp> closing = std::move(tcp);
+          closing->sharedRefUntil<EvClose>();
+          closing->close();
+          (*callback)(nullptr, UV_ECONNREFUSED);
+          return;
+        }
+        host.entries.push_back(Entry{ std::move(tcp), State::CONNECTING, 0 });
+      }
+
+      void lease(Host &host, std::unique_ptr<Tcp> tcp, AcquireCallback cb) {
+        // the loop is running the callback, so it still has an owner
+        tcp->adoptLoop(sharedLoop_.lock());
+        tcp->clearCallbacks();
+        auto hostPtr = &host;
+        tcp->on<EvClose>([this, hostPtr](const auto &e, auto &t) {
+          this->onClosed(*hostPtr, &t);
+        });
+        host.leased.insert(tcp.get());
+        cb(std::move(tcp), 0);
+      }
+
+      std::unique_ptr<Tcp> takeIdle(Host &host) {
+        // the most recently used one, the others may time out
+        for (auto i = host.entries.size(); i > 0; --i) {
+          auto &e = host.entries[i - 1];
+          if (e.state == State::IDLE) {
+            auto tcp = removeEntry(host, e.tcp.get());
+            tcp->readStop();
+            uv_ref(reinterpret_cast<uv_handle_t *>(tcp->get()));
+            return tcp;
+          }
+        }
+        return nullptr;
+      }
+
+      void keepIdle(Host &host, std::unique_ptr<Tcp> tcp) {
+        auto hostPtr = &host;
+        // unexpected data or EOF from the peer, errors close it anyway
+        tcp->setAllowHalfOpen(false);
+        tcp->on<EvRead>([](const auto &e, auto &t) {
+          t.close();
+        });
+        tcp->on<EvClose>([this, hostPtr](const auto &e, auto &t) {
+          this->onClosed(*hostPtr, &t);
+        });
+        tcp->readStart();
+        uv_unref(reinterpret_cast<uv_handle_t *>(tcp->get()));
+        tcp->disownLoop();
+
+        ++host.idleCount;
+        host.entries.push_back(
+          Entry{ std::move(tcp), State::IDLE, uv_now(loop_.getRaw()) });
+        startTimer();
+      }
+
+      void onClosed(Host &host, Tcp *tcp) {
+        --host.total;
+        host.leased.erase(tcp);
+        // destroyed after its last EvClose callback
+        removeEntry(host, tcp);
+
+        if (!host.waiters.empty() && host.total < maxTotal_) {
+          auto cb = std::move(host.waiters.front());
+          host.waiters.pop_front();
+          dial(host, std::move(cb));
+        }
+      }
+
+      void startTimer() {
+        if (!timerInitialized_) {
+          if (uv_timer_init(loop_.getRaw(), &timer_) != 0) {
+            return;
+          }
+          timer_.data = this;
+          uv_unref(reinterpret_cast<uv_handle_t *>(&timer_));
+          timerInitialized_ = true;
+        }
+        if (!uv_is_active(reinterpret_cast<uv_handle_t *>(&timer_))) {
+          auto interval = idleTimeout_ / 4 > 0 ? idleTimeout_ / 4 : 1;
+          uv_timer_start(&timer_, onTimerCallback, interval, interval);
+        }
+      }
+
+      static void onTimerCallback(uv_timer_t *timer) {
+        auto pool = reinterpret_cast<TcpConnectionPool *>(timer->data);
+        auto now = uv_now(pool->loop_.getRaw());
+        auto idle = false;
+        for (auto &h : pool->hosts_) {
+          for (auto &e : h.second.entries) {
+            if (e.state != State::IDLE) {
+              continue;
+            }
+            if (now - e.idleSince >= pool->idleTimeout_) {
+              e.tcp->close();
+            } else {
+              idle = true;
+            }
+          }
+        }
+        if (!idle) {
+          uv_timer_stop(timer);
+        }
+      }
+
+    private:
+      Loop &loop_;
+      std::weak_ptr<Loop> sharedLoop_;
+      std::unordered_map<std::string, Host> hosts_;
+      std::size_t maxIdle_{8};
+      std::size_t maxTotal_{64};
+      uint64_t idleTimeout_{30000};
+      uv_timer_t timer_;
+      bool timerInitialized_{false};
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_TCP_POOL_H_ */
@@ -0,0 +1,248 @@
+#ifndef UVCPP_TCP_SERVER_H_
+#define UVCPP_TCP_SERVER_H_
+#include "tcp.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <linux/filter.h>
+#endif
+
+namespace uvcpp {
+
+  /**
+   * runs a Tcp server on N loops, each on a thread of its own with its own
+   * listener bound to the same address with SO_REUSEPORT, the kernel
+   * spreads the connections over the listeners and the loops share
+   * nothing. setup is called on the thread of each loop before its
+   * listener listens, to subscribe to EvAccept<Tcp> and the like.
+   *
+   * Steering::CPU pins loop i to CPU i and attaches a BPF program to the
+   * group that hands each connection to the listener of the CPU that
+   * received it (Linux only), best with as many loops as CPUs.
+   */
+  class TcpServerGroup {
+    struct Worker {
+      TcpServerGroup *group;
+      std::size_t index;
+      std::thread thread;
+      uv_async_t stopAsync;
+      Tcp *server{nullptr};
+      int fd{-1};
+      // 0 while starting, 1 listening, -1 failed
+      int state{0};
+    };
+
+    public:
+      enum class Steering {
+        NONE,
+        CPU
+      };
+
+      using SetupFn = std::function<void(Tcp &server, std::size_t index)>;
+      // called on the thread of each loop on stop(), connections that are
+      // left open keep their loop running
+      using StopFn = std::function<void(Loop &loop, std::size_t index)>;
+
+      TcpServerGroup(
+        std::size_t loopCount, SetupFn setup, StopFn onStop = nullptr) :
+        loopCount_(loopCount), setup_(std::move(setup)),
+        onStop_(std::move(onStop)) { }
+      TcpServerGroup(const TcpServerGroup &) = delete;
+      TcpServerGroup &operator=(const TcpServerGroup &) = delete;
+
+      ~TcpServerGroup() {
+        stop();
+      }
+
+      /**
+       * the listeners are started one after another, so that listener i
+       * is member i of the SO_REUSEPORT group, returns false if any of
+       * them fails, the others are stopped then
+       */
+      bool start(
+        const std::string &ip, uint16_t port, int backlog = 128,
+        Steering steering = Steering::NONE) {
+        if (!workers_.empty() || loopCount_ == 0) {
+          return false;
+        }
+        if (!NetUtil::convertIPAddress(ip, port, &sas_)) {
+          LOG_E("[%s] is not a valid ip address", ip.c_str());
+          return false;
+        }
+        backlog_ = backlog;
+        steering_ = steering;
+
+        for (std::size_t i = 0; i < loopCount_; ++i) {
+          workers_.emplace_back(std::make_unique<Worker>());
+          auto w = workers_.back().get();
+          w->group = this;
+          w->index = i;
+          w->thread = std::thread(&TcpServerGroup::run, this, w);
+
+          std::unique_lock<std::mutex> lock(mutex_);
+          cond_.wait(lock, [w] { return w->state != 0; });
+          if (w->state < 0) {
+            lock.unlock();
+            stop();
+            return false;
+          }
+        }
+
+        if (steering_ == Steering::CPU) {
+          attachCpuSteering();
+        }
+        return true;
+      }
+
+      /**
+       * closes the listeners and waits for the loops to finish, must not
+       * be called from one of the loops of the group
+       */
+      void stop() {
+        for (auto &w : workers_) {
+          if (w->state > 0) {
+            uv_async_send(&w->stopAsync);
+          }
+        }
+        for (auto &w : workers_) {
+          if (w->thread.joinable()) {
+            w->thread.join();
+          }
+        }
+        workers_.clear();
+      }
+
+      bool isRunning() const {
+        return !workers_.empty();
+      }
+
+      std::size_t getLoopCount() const {
+        return loopCount_;
+      }
+
+    private:
+      void run(Worker *w) {
+        auto loop = std::make_shared<Loop>();
+        if (!loop->init()) {
+          notify(w, -1);
+          return;
+        }
+        if (steering_ == Steering::CPU) {
+          pinToCpu(w->index);
+        }
+
+        auto sa = reinterpret_cast<SockAddr *>(&sas_);
+        auto server = Tcp::createUnique(
+          loop, sa->sa_family == AF_INET6 ?
+          Tcp::Domain::INET6 : Tcp::Domain::INET);
+        if (!server) {
+          notify(w, -1);
+          return;
+        }
+        if (uv_async_init(
+              loop->getRaw(), &w->stopAsync, onStopAsync) != 0) {
+          server->close();
+          notify(w, -1);
+          loop->run();
+          return;
+        }
+        w->stopAsync.data = w;
+        w->server = server.get();
+
+        int on = 1;
+        server->setSockOption(
+          SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+        server->setSockOption(
+          SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+        if (setup_) {
+          setup_(*server, w->index);
+        }
+
+        uv_os_fd_t fd;
+        auto ok = server->bind(sa) && server->listen(backlog_) &&
+          uv_fileno(
+            reinterpret_cast<uv_handle_t *>(server->get()), &fd) == 0;
+        if (ok) {
+          w->fd = fd;
+        } else {
+          server->close();
+          uv_close(reinterpret_cast<uv_handle_t *>(&w->stopAsync), nullptr);
+        }
+        notify(w, ok ? 1 : -1);
+        loop->run();
+      }
+
+      void notify(Worker *w, int state) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        w->state = state;
+        cond_.notify_all();
+      }
+
+      static void onStopAsync(uv_async_t *async) {
+        auto w = reinterpret_cast<Worker *>(async->data);
+        auto loop = w->server->getLoop();
+        w->server->close();
+        uv_close(reinterpret_cast<uv_handle_t *>(async), nullptr);
+        if (w->group->onStop_) {
+          w->group->onStop_(*loop, w->index);
+        }
+      }
+
+      static void pinToCpu(std::size_t index) {
+#if defined(__linux__)
+        auto cpuCount = std::thread::hardware_concurrency();
+        if (cpuCount == 0) {
+          return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % cpuCount, &cpus);
+        int err;
+        if ((err = pthread_setaffinity_np(
+              pthread_self(), sizeof(cpus), &cpus)) != 0) {
+          LOG_W("pthread_setaffinity_np failed: %s", strerror(err));
+        }
+#endif
+      }
+
+      // the group picks listener cpu % N for a connection received on cpu
+      void attachCpuSteering() {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+        struct sock_filter code[] = {
+          { BPF_LD | BPF_W | BPF_ABS, 0, 0,
+            static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) },
+          { BPF_ALU | BPF_MOD | BPF_K, 0, 0,
+            static_cast<uint32_t>(loopCount_) },
+          { BPF_RET | BPF_A, 0, 0, 0 },
+        };
+        struct sock_fprog prog = {
+          static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code
+        };
+        if (setsockopt(workers_[0]->fd, SOL_SOCKET,
+              SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+          LOG_W("SO_ATTACH_REUSEPORT_CBPF failed: %s", strerror(errno));
+        }
+#else
+        LOG_W("cpu steering is not supported on this platform");
+#endif
+      }
+
+    private:
+      std::size_t loopCount_;
+      SetupFn setup_;
+      StopFn onStop_;
+      SockAddrStorage sas_;
+      int backlog_{128};
+      Steering steering_{Steering::NONE};
+      std::vector<std::unique_ptr<Worker>> workers_;
+      std::mutex mutex_;
+      std::condition_variable cond_;
+  };
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_TCP_SERVER_H_ */
@@ -0,0 +1,276 @@
+#ifndef UVCPP_TIMER_WHEEL_H_
+#define UVCPP_TIMER_WHEEL_H_
+#include "loop.hpp"
+#include "uv.h"
+#include "util/log.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// tick of the per-loop TimerWheel, in milliseconds
+#ifndef UVCPP_TIMER_WHEEL_GRANULARITY
+#define UVCPP_TIMER_WHEEL_GRANULARITY 100
+#endif
+
+namespace uvcpp {
+  class TimerWheel;
+
+  /**
+   * a timeout on a TimerWheel, embedded in the object that times out, so
+   * scheduling it allocates nothing. it is cancelled when destroyed.
+   */
+  class TimerWheelEntry {
+    friend class TimerWheel;
+
+    public:
+      using Callback = void (*)(TimerWheelEntry *entry);
+
+      TimerWheelEntry() = default;
+      TimerWheelEntry(Callback callback, void *data) :
+        callback_(callback), data_(data) { }
+      TimerWheelEntry(const TimerWheelEntry &) = delete;
+      TimerWheelEntry &operator=(const TimerWheelEntry &) = delete;
+
+      ~TimerWheelEntry() {
+        cancel();
+      }
+
+      void setCallback(Callback callback, void *data) {
+        callback_ = callback;
+        data_ = data;
+      }
+
+      void *getData() const {
+        return data_;
+      }
+
+      bool isScheduled() const {
+        return wheel_ != nullptr;
+      }
+
+      inline void cancel();
+
+    private:
+      void unlink() {
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = next_ = this;
+      }
+
+    private:
+      // circular list of the slot, the slot heads are entries too
+      TimerWheelEntry *prev_{this};
+      TimerWheelEntry *next_{this};
+      TimerWheel *wheel_{nullptr};
+      uint64_t expiry_{0};
+      Callback callback_{nullptr};
+      void *data_{nullptr};
+  };
+
+  /**
+   * hierarchical timing wheel on one uv_timer_t, for timeouts that are
+   * set and reset often and rarely fire, like the idle and read timeouts
+   * of connections. schedule(), reschedule and cancel() are O(1), entries
+   * fire at most one tick late and never early.
+   *
+   * 4 levels of 64 slots each, the first one holds the next 64 ticks, each
+   * further one 64 times the span of the previous one, whose slots are
+   * refilled from it as they come up. timeouts beyond 2^24 ticks are
+   * clamped to that.
+   *
+   * the timer runs once per tick while entries are scheduled, and does
+   * not keep the loop running.
+   */
+  class TimerWheel : public LoopContext {
+    static constexpr std::size_t kLevels = 4;
+    static constexpr std::size_t kSlotBits = 6;
+    static constexpr std::size_t kSlots = 1 << kSlotBits;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+    static constexpr uint64_t kMaxTicks =
+      (static_cast<uint64_t>(1) << (kSlotBits * kLevels)) - 1;
+
+    public:
+      explicit TimerWheel(
+        Loop &loop, uint64_t granularity = UVCPP_TIMER_WHEEL_GRANULARITY) :
+        loop_(loop), granularity_(granularity > 0 ? granularity : 1) { }
+      TimerWheel(const TimerWheel &) = delete;
+      TimerWheel &operator=(const TimerWheel &) = delete;
+
+      virtual ~TimerWheel() {
+        for (auto &level : slots_) {
+          for (auto &head : level) {
+            while (head.next_ != &head) {
+              auto entry = head.next_;
+              entry->unlink();
+              entry->wheel_ = nullptr;
+            }
+          }
+        }
+      }
+
+      void closeHandles() override {
+        if (timerInitialized_) {
+          loop_.closeHandle(reinterpret_cast<uv_handle_t *>(&timer_));
+        }
+      }
+
+      // the wheel of the loop
+      static TimerWheel &of(Loop &loop) {
+        return loop.getContext<TimerWheel>();
+      }
+
+      // in milliseconds, can only be changed while nothing is scheduled
+      bool setGranularity(uint64_t granularity) {
+        if (size_ > 0) {
+          return false;
+        }
+        granularity_ = granularity > 0 ? granularity : 1;
+        return true;
+      }
+
+      uint64_t getGranularity() const {
+        return granularity_;
+      }
+
+      /**
+       * (re)schedules entry to fire after timeout milliseconds, an entry
+       * that is scheduled already, on this wheel or another, is moved
+       */
+      void schedule(TimerWheelEntry &entry, uint64_t timeout) {
+        if (entry.wheel_ == this) {
+          entry.unlink();
+        } else {
+          entry.cancel();
+          if (size_ == 0 && !start()) {
+            return;
+          }
+          ++size_;
+        }
+
+        // the part of the current tick that is gone already counts too
+        auto now = uv_now(loop_.getRaw());
+        auto elapsed = now > base_ + current_ * granularity_ ?
+          now - base_ - current_ * granularity_ : 0;
+        auto ticks = (timeout + elapsed + granularity_ - 1) / granularity_;
+        ticks = ticks < 1 ? 1 : (ticks > kMaxTicks ? kMaxTicks : ticks);
+
+        entry.expiry_ = current_ + ticks;
+        entry.wheel_ = this;
+        place(entry);
+      }
+
+      void cancel(TimerWheelEntry &entry) {
+        if (entry.wheel_ != this) {
+          return;
+        }
+        entry.unlink();
+        entry.wheel_ = nullptr;
+        if (--size_ == 0) {
+          uv_timer_stop(&timer_);
+        }
+      }
+
+      std::size_t size() const {
+        return size_;
+      }
+
+    private:
+      void place(TimerWheelEntry &entry) {
+        auto delta = entry.expiry_ - current_;
+        std::size_t level = 0;
+        while (level < kLevels - 1 &&
+               delta >= (static_cast<uint64_t>(1) <<
+                         (kSlotBits * (level + 1)))) {
+          ++level;
+        }
+        auto &head = slots_[level][
+          (entry.expiry_ >> (kSlotBits * level)) & kSlotMask];
+        entry.prev_ = head.prev_;
+        entry.next_ = &head;
+        head.prev_->next_ = &entry;
+        head.prev_ = &entry;
+      }
+
+      bool start() {
+        if (!timerInitialized_) {
+          if (uv_timer_init(loop_.getRaw(), &timer_) != 0) {
+            LOG_E("uv_timer_init failed");
+            return false;
+          }
+          timer_.data = this;
+          uv_unref(reinterpret_cast<uv_handle_t *>(&timer_));
+          timerInitialized_ = true;
+        }
+        // the wheel stood still while empty, tick current_ starts now
+        base_ = uv_now(loop_.getRaw()) - current_ * granularity_;
+        uv_timer_start(&timer_, onTimerCallback, granularity_, granularity_);
+        return true;
+      }
+
+      // moves the entries of the slot that comes up down a level
+      void cascade(std::size_t level) {
+        auto &head = slots_[level][
+          (current_ >> (kSlotBits * level)) & kSlotMask];
+        while (head.next_ != &head) {
+          auto entry = head.next_;
+          entry->unlink();
+          place(*entry);
+        }
+      }
+
+      void tick() {
+        ++current_;
+        for (std::size_t level = 1; level < kLevels; ++level) {
+          if ((current_ & ((static_cast<uint64_t>(1) <<
+                            (kSlotBits * level)) - 1)) != 0) {
+            break;
+          }
+          cascade(level);
+        }
+
+        // callbacks may schedule or cancel any entry, this one included
+        auto &head = slots_[0][current_ & kSlotMask];
+        while (head.next_ != &head) {
+          auto entry = head.next_;
+          entry->unlink();
+          entry->wheel_ = nullptr;
+          --size_;
+          if (entry->callback_) {
+            entry->callback_(entry);
+          }
+        }
+      }
+
+      static void onTimerCallback(uv_timer_t *timer) {
+        auto wheel = reinterpret_cast<TimerWheel *>(timer->data);
+        auto now = uv_now(wheel->loop_.getRaw());
+        // catches up with the ticks a busy loop missed, base_ moves if a
+        // callback empties the wheel and schedules again
+        while (wheel->size_ > 0 &&
+               wheel->current_ < (now - wheel->base_) / wheel->granularity_) {
+          wheel->tick();
+        }
+        if (wheel->size_ == 0) {
+          uv_timer_stop(timer);
+        }
+      }
+
+    private:
+      Loop &loop_;
+      uint64_t granularity_;
+      uint64_t base_{0};
+      uint64_t current_{0};
+      std::size_t size_{0};
+      TimerWheelEntry slots_[kLevels][kSlots];
+      uv_timer_t timer_;
+      bool timerInitialized_{false};
+  };
+
+  void TimerWheelEntry::cancel() {
+    if (wheel_) {
+      wheel_->cancel(*this);
+    }
+  }
+
+} /* end of namspace: uvcpp */
+
+#endif /* end of include guard: UVCPP_TIMER_WHEEL_H_ */
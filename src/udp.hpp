@@ -4,7 +4,7 @@
 #include "defs.h"
 #include "util.hpp"
 #include "req.hpp"
-#include <deque>
+#include "read_buffer.hpp"
 
 namespace uvcpp {
   
@@ -31,13 +31,11 @@ namespace uvcpp {
         }
 
         this->template once<EvError>([this](const auto &e, auto &udp){
-          if (!pendingReqs_.empty()) {
-            for (auto &r : pendingReqs_) {
-              this->template publish<EvBufferRecycled>(
-                EvBufferRecycled{ std::move(r->buffer) });
-            }
-            pendingReqs_.clear();
-          }
+          pendingReqs_.forEach([this](auto &r){
+            this->template publish<EvBufferRecycled>(
+              EvBufferRecycled{ std::move(r.buffer) });
+          });
+          pendingReqs_.clear();
         });
         return true;
       }
@@ -98,10 +96,11 @@ namespace uvcpp {
       bool send(std::unique_ptr<nul::Buffer> buffer, const SockAddr *sa) {
         auto rawBuffer = buffer->asPod();
 
-        auto req = UdpSendReq::createUnique(this->getLoop(), std::move(buffer));
+        auto req = ReqPool<UdpSendReq>::of(this->get()->loop).acquire();
+        req->buffer = std::move(buffer);
         auto rawReq = req->get();
 
-        pendingReqs_.push_back(std::move(req));
+        pendingReqs_.push(std::move(req));
 
         int err;
         if ((err = uv_udp_send(
@@ -124,6 +123,15 @@ namespace uvcpp {
         return send(std::move(buffer), sas_.get());
       }
 
+      /**
+       * where received datagrams go, overrides the policy of the loop,
+       * nullptr falls back to the loop policy or the built-in buffer.
+       * datagrams larger than the buffer are truncated.
+       */
+      void setReadBufferPolicy(std::shared_ptr<ReadBufferPolicy> policy) {
+        readBufferPolicy_ = std::move(policy);
+      }
+
       void setDesitinationAddr(const std::string &ip, uint16_t port) {
         SockAddrStorage sas;
         if (NetUtil::convertIPAddress(ip, port, &sas)) {
@@ -178,9 +186,19 @@ namespace uvcpp {
         }
       }
 
+      ReadBufferPolicy *getActiveReadBufferPolicy() {
+        return readBufferPolicy_ ?
+          readBufferPolicy_.get() :
+          Loop::fromRaw(this->get()->loop)->getReadBufferPolicy();
+      }
+
       static void onAllocCallback(
           uv_handle_t *handle, std::size_t size, uv_buf_t *buf) {
         auto udp = reinterpret_cast<Udp *>(handle->data);
+        if (auto policy = udp->getActiveReadBufferPolicy()) {
+          policy->allocate(handle, size, buf);
+          return;
+        }
         buf->base = udp->recvBuf_;
         buf->len = sizeof(udp->recvBuf_);
       }
@@ -188,30 +206,28 @@ namespace uvcpp {
       static void onRecvCallback(
           uv_udp_t *handle, ssize_t nread, const uv_buf_t *buf,
           const SockAddr* addr, unsigned int flags) {
-        if (nread == 0 && !addr) {
-          // nothing to read
-          return;
+        auto udp = reinterpret_cast<Udp *>(handle->data);
+        // nread may be 0 for empty packet, or nothing to read if !addr
+        if (nread >= 0 && addr) {
+          udp->template publish<EvRecv>(EvRecv{ buf->base, nread, addr });
         }
 
-        auto udp = reinterpret_cast<Udp *>(handle->data);
+        if (auto policy = udp->getActiveReadBufferPolicy()) {
+          policy->release(
+            reinterpret_cast<uv_handle_t *>(handle), buf, nread);
+        }
         if (nread < 0) {
           LOG_E("TCP read failed: %s", uv_strerror(nread));
           udp->close();
-          return;
         }
-
-        // nread may be 0 for empty packet
-        udp->template publish<EvRecv>(EvRecv{ buf->base, nread, addr });
       }
 
       static void onSendCallback(uv_udp_send_t *req, int status) {
         auto udp = reinterpret_cast<Udp *>(req->handle->data);
-        if (!udp->pendingReqs_.empty()) {
-          auto req = std::move(udp->pendingReqs_.front());
-          udp->pendingReqs_.pop_front();
-
+        if (auto sendReq = udp->pendingReqs_.pop()) {
           udp->template publish<EvBufferRecycled>(
-            EvBufferRecycled{ std::move(req->buffer) });
+            EvBufferRecycled{ std::move(sendReq->buffer) });
+          ReqPool<UdpSendReq>::of(req->handle->loop).recycle(std::move(sendReq));
         }
 
         if (status < 0) {
@@ -222,9 +238,10 @@ namespace uvcpp {
       }
 
     private:
-      std::deque<std::unique_ptr<UdpSendReq>> pendingReqs_{};
+      ReqQueue<UdpSendReq> pendingReqs_{};
       std::unique_ptr<SockAddr, CPointerDeleterType> localSa_{nullptr, CPointerDeleter};
       std::unique_ptr<SockAddr, CPointerDeleterType> sas_{nullptr, CPointerDeleter};
+      std::shared_ptr<ReadBufferPolicy> readBufferPolicy_{nullptr};
       char recvBuf_[PACKET_BUF];
   };
 
@@ -7,8 +7,14 @@
 #include "udp.hpp"
 #include "pipe.hpp"
 #include "timer.hpp"
+#include "timer_wheel.hpp"
 #include "prepare.hpp"
 #include "poll.hpp"
+#include "relay.hpp"
+#include "framing.hpp"
+#include "tcp_server.hpp"
+#include "tcp_pool.hpp"
+#include "happy_eyeballs.hpp"
 #include "ext/poll_unix_sock.hpp"
 
 #endif /* end of include guard: UVCPP_H_ */
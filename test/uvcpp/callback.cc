@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+#include <atomic>
+
+using namespace uvcpp;
+
+static std::atomic<int> allocCount{0};
+
+void *operator new(std::size_t size) {
+  ++allocCount;
+  if (auto p = malloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  free(p);
+}
+
+struct EvFoo : public Event {
+  EvFoo(int value) : value(value) { }
+  int value;
+};
+struct EvBar : public Event { };
+
+class Foo : public Resource<uv_idle_t, Foo> {
+  public:
+    Foo(const std::shared_ptr<Loop> &loop) : Resource(loop) { }
+    void fire(int value) {
+      publish<EvFoo>(EvFoo{ value });
+    }
+    void fireBar() {
+      publish<EvBar>(EvBar{});
+    }
+};
+
+TEST(Callback, NoAllocation) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto foo = Foo::createUnique(loop);
+
+  auto sum = 0;
+  auto onceCount = 0;
+  auto before = allocCount.load();
+  for (int i = 0; i < 6; ++i) {
+    foo->on<EvFoo>([&sum](const auto &e, auto &foo) {
+      sum += e.value;
+    });
+  }
+  foo->once<EvFoo>([&onceCount](const auto &e, auto &foo) {
+    ++onceCount;
+  });
+  foo->fire(1);
+  foo->fire(2);
+  ASSERT_EQ(allocCount.load(), before);
+
+  ASSERT_EQ(sum, 18);
+  ASSERT_EQ(onceCount, 1);
+}
+
+TEST(Callback, RegisterWhileDispatching) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto foo = Foo::createUnique(loop);
+
+  auto fooCount = 0;
+  auto barCount = 0;
+  foo->on<EvFoo>([&](const auto &e, auto &foo) {
+    ++fooCount;
+    // enough callbacks to spill over the inline slots
+    for (int i = 0; i < 20; ++i) {
+      foo.template on<EvFoo>([&fooCount](const auto &e, auto &foo) {
+        ++fooCount;
+      });
+      foo.template once<EvBar>([&barCount](const auto &e, auto &foo) {
+        ++barCount;
+      });
+    }
+  });
+
+  foo->fire(0);
+  ASSERT_EQ(fooCount, 1);
+
+  foo->fireBar();
+  foo->fireBar();
+  ASSERT_EQ(barCount, 20);
+}
+
+TEST(Callback, LargeCallable) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto foo = Foo::createShared(loop);
+
+  char payload[128] = "large";
+  auto result = std::string{};
+  foo->once<EvFoo>([payload, &result](const auto &e, auto &foo) {
+    result = payload;
+  });
+  foo->sharedRefUntil<EvFoo>();
+  foo->fire(0);
+  ASSERT_EQ(result, "large");
+}
+
+class Bar;
+
+template <>
+struct uvcpp::EventTraits<Bar> {
+  using Events = EventList<EvFoo, EvError>;
+};
+
+class Bar : public Resource<uv_idle_t, Bar> {
+  public:
+    Bar(const std::shared_ptr<Loop> &loop) : Resource(loop) { }
+    void fire(int value) {
+      publish<EvFoo>(EvFoo{ value });
+    }
+    void fireBar() {
+      publish<EvBar>(EvBar{});
+    }
+};
+
+static_assert(EventIndex<EvFoo, EventList<EvFoo, EvError>>::value == 0, "");
+static_assert(EventIndex<EvError, EventList<EvFoo, EvError>>::value == 1, "");
+static_assert(EventIndex<EvBar, EventList<EvFoo, EvError>>::value == 2, "");
+
+TEST(Callback, ListedEvents) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto bar = Bar::createUnique(loop);
+
+  auto sum = 0;
+  auto onceCount = 0;
+  auto barCount = 0;
+  for (int i = 0; i < 10; ++i) {
+    bar->once<EvFoo>([&onceCount](const auto &e, auto &bar) {
+      ++onceCount;
+    });
+    bar->on<EvFoo>([&sum](const auto &e, auto &bar) {
+      sum += e.value;
+    });
+    // not listed for Bar, dispatched by scanning
+    bar->on<EvBar>([&barCount](const auto &e, auto &bar) {
+      ++barCount;
+    });
+  }
+
+  bar->fire(1);
+  bar->fire(2);
+  bar->fireBar();
+  ASSERT_EQ(sum, 30);
+  ASSERT_EQ(onceCount, 10);
+  ASSERT_EQ(barCount, 10);
+
+  // slots of the fired ONCE callbacks are reused
+  auto before = allocCount.load();
+  for (int i = 0; i < 10; ++i) {
+    bar->once<EvFoo>([&onceCount](const auto &e, auto &bar) {
+      ++onceCount;
+    });
+  }
+  ASSERT_EQ(allocCount.load(), before);
+  bar->fire(0);
+  ASSERT_EQ(onceCount, 20);
+}
+
+TEST(Callback, Off) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto foo = Foo::createUnique(loop);
+  auto bar = Bar::createUnique(loop);
+
+  auto fooCount = 0;
+  auto sub = foo->on<EvFoo>([&fooCount](const auto &e, auto &foo) {
+    ++fooCount;
+  });
+  foo->fire(0);
+  ASSERT_TRUE(foo->off(sub));
+  ASSERT_FALSE(foo->off(sub));
+  // a Subscription only works with the resource that returned it
+  ASSERT_FALSE(bar->off(sub));
+  foo->fire(0);
+  ASSERT_EQ(fooCount, 1);
+
+  // a callback removes itself and a sibling while being called
+  auto barCount = 0;
+  Subscription first, second;
+  first = bar->on<EvFoo>([&](const auto &e, auto &bar) {
+    ++barCount;
+    ASSERT_TRUE(bar.off(first));
+    ASSERT_TRUE(bar.off(second));
+  });
+  second = bar->on<EvFoo>([&](const auto &e, auto &bar) {
+    FAIL() << "removed before being called";
+  });
+  bar->fire(0);
+  bar->fire(0);
+  ASSERT_EQ(barCount, 1);
+
+  // fired ONCE callbacks can not be removed
+  auto onceSub = bar->once<EvFoo>([](const auto &e, auto &bar) { });
+  bar->fire(0);
+  ASSERT_FALSE(bar->off(onceSub));
+}
+
+TEST(Callback, OffKeepsStoreFlat) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto foo = Foo::createUnique(loop);
+  auto bar = Bar::createUnique(loop);
+
+  auto count = 0;
+  auto before = allocCount.load();
+  for (int i = 0; i < 1000; ++i) {
+    auto fooSub = foo->on<EvFoo>([&count](const auto &e, auto &foo) {
+      ++count;
+    });
+    auto barSub = bar->on<EvFoo>([&count](const auto &e, auto &bar) {
+      ++count;
+    });
+    foo->fire(0);
+    bar->fire(0);
+    ASSERT_TRUE(foo->off(fooSub));
+    ASSERT_TRUE(bar->off(barSub));
+  }
+  ASSERT_EQ(allocCount.load(), before);
+  ASSERT_EQ(count, 2000);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+#include <atomic>
+#include <vector>
+
+using namespace uvcpp;
+
+// every allocation is prefixed with its size, so the live heap bytes
+// can be tracked without relying on sized deallocation
+static std::atomic<long> liveBytes{0};
+static constexpr std::size_t kHeader = alignof(std::max_align_t);
+
+void *operator new(std::size_t size) {
+  auto p = static_cast<char *>(malloc(size + kHeader));
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<std::size_t *>(p) = size;
+  liveBytes += size;
+  return p + kHeader;
+}
+
+void operator delete(void *p) noexcept {
+  if (p) {
+    auto raw = static_cast<char *>(p) - kHeader;
+    liveBytes -= *reinterpret_cast<std::size_t *>(raw);
+    free(raw);
+  }
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+template <typename H, typename ...Args>
+long heapPerHandle(const std::shared_ptr<Loop> &loop, Args ...args) {
+  const auto count = 1000;
+  std::vector<std::unique_ptr<H>> handles;
+  handles.reserve(count);
+
+  auto before = liveBytes.load();
+  for (auto i = 0; i < count; ++i) {
+    handles.push_back(H::createUnique(loop, args...));
+  }
+  auto perHandle = (liveBytes.load() - before) / count;
+
+  for (auto &h : handles) {
+    h->close();
+  }
+  loop->run();
+  return perHandle;
+}
+
+TEST(Footprint, Report) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto tcpHeap = heapPerHandle<Tcp>(loop, Tcp::Domain::INET);
+  auto pipeHeap = heapPerHandle<Pipe>(loop, false);
+  auto timerHeap = heapPerHandle<Timer>(loop);
+
+#ifdef UVCPP_COMPACT_HANDLES
+  LOG_I("compact handle footprint:");
+#else
+  LOG_I("default handle footprint:");
+#endif
+  LOG_I("  Tcp:   sizeof=%zu heap=%ld", sizeof(Tcp), tcpHeap);
+  LOG_I("  Pipe:  sizeof=%zu heap=%ld", sizeof(Pipe), pipeHeap);
+  LOG_I("  Timer: sizeof=%zu heap=%ld", sizeof(Timer), timerHeap);
+  LOG_I("  WriteReq: sizeof=%zu", sizeof(WriteReq));
+
+  // a handle that nobody listens to costs exactly its own object
+  ASSERT_EQ(tcpHeap, static_cast<long>(sizeof(Tcp)));
+  ASSERT_EQ(pipeHeap, static_cast<long>(sizeof(Pipe)));
+  ASSERT_EQ(timerHeap, static_cast<long>(sizeof(Timer)));
+
+  // a write request is the libuv request plus its buffers and link
+  ASSERT_LE(sizeof(WriteReq), sizeof(uv_write_t) + 4 * sizeof(void *));
+#ifdef UVCPP_COMPACT_HANDLES
+  ASSERT_LE(sizeof(Tcp), 768u);
+  ASSERT_LE(sizeof(Pipe), 768u);
+#endif
+}
+
+TEST(Footprint, LazyCallbackSlots) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto before = liveBytes.load();
+  auto tcp = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto subscriptionHeap = liveBytes.load();
+  tcp->on<EvRead>([](const auto &e, auto &tcp) { });
+  subscriptionHeap = liveBytes.load() - subscriptionHeap;
+  LOG_I("heap after the first subscription: %ld", subscriptionHeap);
+
+#ifdef UVCPP_COMPACT_HANDLES
+  // callback slots are allocated on the first subscription
+  ASSERT_GT(subscriptionHeap, 0);
+#else
+  ASSERT_EQ(subscriptionHeap, 0);
+#endif
+
+  tcp->close();
+  loop->run();
+  tcp.reset();
+  ASSERT_EQ(liveBytes.load(), before);
+}
@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+
+using namespace uvcpp;
+
+// feeds the input split at every position, the frames must not change
+template <typename F>
+void testSplits(
+  F &framer, const std::string &input,
+  const std::vector<std::string> &expected) {
+  std::vector<std::string> frames;
+  auto sub = framer.template on<EvFrame>([&frames](const auto &e, auto &f) {
+    frames.emplace_back(e.data, e.size);
+  });
+  for (std::size_t i = 0; i <= input.size(); ++i) {
+    for (std::size_t j = i; j <= input.size(); ++j) {
+      frames.clear();
+      ASSERT_TRUE(framer.feed(input.data(), i));
+      ASSERT_TRUE(framer.feed(input.data() + i, j - i));
+      ASSERT_TRUE(framer.feed(input.data() + j, input.size() - j));
+      ASSERT_EQ(frames, expected);
+      ASSERT_EQ(framer.getPendingSize(), 0u);
+    }
+  }
+  framer.off(sub);
+}
+
+TEST(Framing, LengthPrefix) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto be = LengthPrefixFramer::createUnique(loop, 2, ByteOrder::BIG);
+  testSplits(
+    *be, std::string("\x00\x03" "abc" "\x00\x00" "\x00\x01" "d", 10),
+    { "abc", "", "d" });
+
+  // a type byte before a little-endian length
+  auto le = LengthPrefixFramer::createUnique(loop, 4, ByteOrder::LITTLE, 1);
+  std::string header;
+  le->on<EvFrame>([&header](const auto &e, auto &f) {
+    header.assign(e.header, e.headerSize);
+  });
+  testSplits(
+    *le, std::string("T\x02\x00\x00\x00" "hi" "U\x01\x00\x00\x00" "!", 13),
+    { "hi", "!" });
+  ASSERT_EQ(header, std::string("U\x01\x00\x00\x00", 5));
+}
+
+TEST(Framing, Varint) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto framer = VarintFramer::createUnique(loop);
+  auto large = std::string(300, 'x');
+  // 300 is 0xac 0x02
+  testSplits(
+    *framer, "\x03" "abc" "\xac\x02" + large + std::string("\x00", 1),
+    { "abc", large, "" });
+}
+
+TEST(Framing, Delimiter) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto lines = DelimiterFramer::createUnique(loop);
+  testSplits(*lines, "one\ntwo\n\nthree\n", { "one", "two", "", "three" });
+
+  auto records = DelimiterFramer::createUnique(loop, "\r\n");
+  testSplits(*records, "a\rb\r\n\r\nc\r\r\n", { "a\rb", "", "c\r" });
+}
+
+TEST(Framing, MaxFrameSize) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto framer = DelimiterFramer::createUnique(loop, "\n", 8);
+  auto errors = 0;
+  auto frames = 0;
+  framer->on<EvError>([&errors](const auto &e, auto &f) {
+    ASSERT_EQ(e.status, UV_EMSGSIZE);
+    ++errors;
+  });
+  framer->on<EvFrame>([&frames](const auto &e, auto &f) {
+    ++frames;
+  });
+
+  ASSERT_TRUE(framer->feed("12345", 5));
+  ASSERT_FALSE(framer->feed("6789\n", 5));
+  // ignored until reset
+  ASSERT_FALSE(framer->feed("ok\n", 3));
+  framer->reset();
+  ASSERT_TRUE(framer->feed("ok\n", 3));
+  ASSERT_EQ(errors, 1);
+  ASSERT_EQ(frames, 1);
+
+  auto prefixed = LengthPrefixFramer::createUnique(
+    loop, 4, ByteOrder::BIG, 0, 0, 1024);
+  prefixed->on<EvError>([&errors](const auto &e, auto &f) {
+    ++errors;
+  });
+  ASSERT_FALSE(prefixed->feed("\x7f\xff\xff\xff", 4));
+  ASSERT_EQ(errors, 2);
+
+  // a limit below the header size rejects every frame
+  auto tiny = LengthPrefixFramer::createUnique(
+    loop, 4, ByteOrder::BIG, 0, 0, 2);
+  tiny->on<EvError>([&errors](const auto &e, auto &f) {
+    ASSERT_EQ(e.status, UV_EMSGSIZE);
+    ++errors;
+  });
+  ASSERT_FALSE(tiny->feed(std::string("\x00\x00\x00\x00", 4).data(), 4));
+  ASSERT_EQ(errors, 3);
+}
+
+TEST(Framing, DeclaredSizeNotReserved) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  // a header alone, declaring a frame just below the limit
+  auto framer = LengthPrefixFramer::createUnique(loop);
+  ASSERT_TRUE(framer->feed("\x00\xff\xff\x00" "abc", 7));
+  ASSERT_EQ(framer->getPendingSize(), 7u);
+  ASSERT_LE(framer->getPendingCapacity(),
+            static_cast<std::size_t>(UVCPP_FRAME_RESERVE_SIZE));
+}
+
+TEST(Framing, VarintOverflow) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto framer = VarintFramer::createUnique(loop);
+  auto status = 0;
+  framer->on<EvError>([&status](const auto &e, auto &f) {
+    status = e.status;
+  });
+  // the 10th byte carries bits beyond 64
+  ASSERT_FALSE(framer->feed(
+      "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02", 10));
+  ASSERT_EQ(status, UV_EPROTO);
+}
+
+TEST(Framing, Tcp) {
+  const int kFrames = 10000;
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+  auto framer = VarintFramer::createUnique(loop);
+  std::shared_ptr<Tcp> acceptedClient;
+
+  auto received = 0;
+  framer->on<EvFrame>([&](const auto &e, auto &f) {
+    auto expected = std::to_string(received);
+    ASSERT_EQ(std::string(e.data, e.size), expected);
+    if (++received == kFrames) {
+      client->close();
+      acceptedClient->close();
+      server->close();
+    }
+  });
+
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    framer->attach(*e.client);
+    e.client->readStart();
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    std::string out;
+    for (int i = 0; i < kFrames; ++i) {
+      auto payload = std::to_string(i);
+      out += static_cast<char>(payload.size());
+      out += payload;
+    }
+    auto buf = std::make_unique<nul::Buffer>(out.size());
+    buf->assign(out.data(), out.size());
+    c.writeAsync(std::move(buf));
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22337));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22337));
+
+  loop->run();
+
+  ASSERT_EQ(received, kFrames);
+}
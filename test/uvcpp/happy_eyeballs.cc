@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+
+using namespace uvcpp;
+
+TEST(HappyEyeballs, Connect) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  std::unique_ptr<Tcp> conn;
+  std::string received;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    conn = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+    conn->template on<EvRead>([&](const auto &e, auto &c) {
+      received.append(e.buf, e.nread);
+      c.close();
+      server->close();
+    });
+    conn->readStart();
+  });
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  ASSERT_TRUE(server->bind("127.0.0.1", 22340));
+  ASSERT_TRUE(server->listen(50));
+
+  auto client = Tcp::createUnique(loop);
+  auto connected = false;
+  client->on<EvError>([](const auto &e, auto &c) {
+    FAIL() << "failed with status: " << e.status;
+  });
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    connected = true;
+    ASSERT_EQ(c.getPort(), 22340);
+    // the socket of the winning attempt now belongs to client
+    auto buf = std::make_unique<nul::Buffer>(5);
+    buf->assign("hello", 5);
+    c.writeAsync(std::move(buf));
+  });
+  client->on<EvWrite>([](const auto &e, auto &c) {
+    c.close();
+  });
+  ASSERT_TRUE(HappyEyeballs::connect(*client, "localhost", 22340));
+
+  loop->run();
+  ASSERT_TRUE(connected);
+  ASSERT_EQ(received, "hello");
+}
+
+TEST(HappyEyeballs, AllAttemptsFail) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto client = Tcp::createUnique(loop);
+  auto status = 0;
+  auto closed = false;
+  client->on<EvConnect>([](const auto &e, auto &c) {
+    FAIL() << "nothing listens on the port";
+  });
+  client->on<EvError>([&](const auto &e, auto &c) {
+    status = e.status;
+  });
+  client->on<EvClose>([&](const auto &e, auto &c) {
+    closed = true;
+  });
+  ASSERT_TRUE(HappyEyeballs::connect(*client, "localhost", 22341));
+
+  loop->run();
+  ASSERT_EQ(status, UV_ECONNREFUSED);
+  ASSERT_TRUE(closed);
+}
+
+TEST(HappyEyeballs, Cancel) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto client = Tcp::createUnique(loop);
+  client->on<EvConnect>([](const auto &e, auto &c) {
+    FAIL() << "the connect was cancelled";
+  });
+  client->on<EvError>([](const auto &e, auto &c) {
+    FAIL() << "failed with status: " << e.status;
+  });
+  ASSERT_TRUE(HappyEyeballs::connect(*client, "localhost", 22341));
+  client->close();
+
+  // nothing of the race is left to keep the loop running
+  loop->run();
+}
+
+TEST(HappyEyeballs, ConnectedTcp) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto client = Tcp::createUnique(loop, Tcp::Domain::INET);
+  ASSERT_FALSE(HappyEyeballs::connect(*client, "localhost", 22341));
+  client->close();
+  loop->run();
+}
@@ -37,7 +37,7 @@ TEST(Poll, UnixDomainSocket) {
 
     auto p = Poll::createUnique(serverPoll.getLoop());
     p->initWithSockHandle(cSock);
-    p->template on<EvPoll>([&](const auto &e, auto &p){
+    p->template on<EvPoll>([&, cSock](const auto &e, auto &p){
       char buf[1024];
       read(cSock, buf, sizeof(buf));
       LOG_D("received from client: %s", buf);
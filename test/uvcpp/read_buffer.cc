@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+
+using namespace uvcpp;
+
+TEST(ReadBuffer, Pool) {
+  ReadBufferPool pool{2};
+
+  std::size_t size = 1500;
+  auto buf = pool.take(size);
+  ASSERT_EQ(size, 2048u);
+  pool.give(buf, size);
+
+  // released buffers are reused by the same size class
+  std::size_t sameClass = 2000;
+  ASSERT_EQ(pool.take(sameClass), buf);
+  ASSERT_EQ(sameClass, 2048u);
+  pool.give(buf, sameClass);
+
+  // buffers above the largest class are not pooled
+  std::size_t large = 4 << 20;
+  auto largeBuf = pool.take(large);
+  ASSERT_EQ(large, 4u << 20);
+  pool.give(largeBuf, large);
+}
+
+TEST(ReadBuffer, Adaptive) {
+  auto pool = std::make_shared<ReadBufferPool>();
+  AdaptiveReadBufferPolicy policy{pool, 1024, 8192};
+  uv_buf_t buf;
+
+  // grows when the reads fill the buffer
+  for (int i = 0; i < 5; ++i) {
+    policy.allocate(nullptr, 65536, &buf);
+    policy.release(nullptr, &buf, buf.len);
+  }
+  ASSERT_EQ(policy.getBufferSize(), 8192u);
+
+  // shrinks after a run of small reads
+  for (int i = 0; i < 4; ++i) {
+    policy.allocate(nullptr, 65536, &buf);
+    policy.release(nullptr, &buf, 10);
+  }
+  ASSERT_EQ(policy.getBufferSize(), 4096u);
+
+  // EAGAIN and errors do not count
+  policy.allocate(nullptr, 65536, &buf);
+  policy.release(nullptr, &buf, 0);
+  policy.allocate(nullptr, 65536, &buf);
+  policy.release(nullptr, &buf, UV_EOF);
+  ASSERT_EQ(policy.getBufferSize(), 4096u);
+}
+
+TEST(ReadBuffer, Tcp) {
+  const std::size_t kTotal = 256 * 1024;
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto pool = std::make_shared<ReadBufferPool>();
+  loop->setReadBufferPolicy(std::make_shared<PooledReadBufferPolicy>(pool));
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+
+  std::size_t received = 0;
+  std::size_t clientReads = 0;
+  std::shared_ptr<Tcp> acceptedClient;
+  auto adaptive = std::make_shared<AdaptiveReadBufferPolicy>(pool, 1024);
+
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    e.client->setReadBufferPolicy(adaptive);
+    e.client->template on<EvRead>([&](const auto &e, auto &c) {
+      for (ssize_t i = 0; i < e.nread; ++i) {
+        ASSERT_EQ(e.buf[i], static_cast<char>((received + i) & 0x7f));
+      }
+      received += e.nread;
+    });
+    e.client->template on<EvClose>([&](const auto &e, auto &c) {
+      s.close();
+    });
+    e.client->readStart();
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    auto buf = std::make_unique<nul::Buffer>(kTotal);
+    for (std::size_t i = 0; i < kTotal; ++i) {
+      buf->getData()[i] = static_cast<char>(i & 0x7f);
+    }
+    buf->setLength(kTotal);
+    c.writeAsync(std::move(buf));
+    c.template on<EvShutdown>([](const auto &e, auto &c) {
+      c.close();
+    });
+    c.shutdown();
+    c.readStart();
+  });
+  // the client reads through the policy of the loop
+  client->on<EvRead>([&](const auto &e, auto &c) {
+    ++clientReads;
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22336));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22336));
+
+  loop->run();
+
+  ASSERT_EQ(received, kTotal);
+  ASSERT_EQ(clientReads, 0u);
+  ASSERT_GT(adaptive->getBufferSize(), 1024u);
+}
+
+TEST(ReadBuffer, Owned) {
+  const std::size_t kTotal = 64 * 1024;
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  auto pool = std::make_shared<BufferPool>(4096);
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+  std::shared_ptr<Tcp> acceptedClient;
+
+  // the server echoes the read buffers back without copying them
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    e.client->template on<EvReadOwned>([&](const auto &e, auto &c) {
+      ASSERT_LE(e.buffer->getLength(), pool->getBufferSize());
+      c.writeAsync(std::move(const_cast<EvReadOwned &>(e).buffer));
+    });
+    e.client->template on<EvBufferRecycled>([&](const auto &e, auto &c) {
+      pool->recycle(std::move(const_cast<EvBufferRecycled &>(e).buffer));
+    });
+    e.client->readStartOwned(pool);
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  std::size_t received = 0;
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    auto buf = std::make_unique<nul::Buffer>(kTotal);
+    for (std::size_t i = 0; i < kTotal; ++i) {
+      buf->getData()[i] = static_cast<char>(i & 0x7f);
+    }
+    buf->setLength(kTotal);
+    c.writeAsync(std::move(buf));
+    c.readStartOwned(pool);
+  });
+  // not moved out, returned to the pool after the callback
+  client->on<EvReadOwned>([&](const auto &e, auto &c) {
+    auto data = e.buffer->getData();
+    for (std::size_t i = 0; i < e.buffer->getLength(); ++i) {
+      ASSERT_EQ(data[i], static_cast<char>((received + i) & 0x7f));
+    }
+    received += e.buffer->getLength();
+    if (received == kTotal) {
+      c.close();
+      acceptedClient->close();
+      server->close();
+    }
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22336));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22336));
+
+  loop->run();
+
+  ASSERT_EQ(received, kTotal);
+  ASSERT_GT(pool->getFreeCount(), 0u);
+}
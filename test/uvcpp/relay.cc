@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+
+using namespace uvcpp;
+
+// client <-> accepted[0] <= relay => upstream <-> accepted[1]
+void testRelay(Relay::Mode mode, bool expectSplicing) {
+  const std::size_t kRequestSize = 1024 * 1024;
+  const std::size_t kResponseSize = 100 * 1024;
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+  auto upstream = Tcp::createUnique(loop);
+  std::vector<std::shared_ptr<Tcp>> accepted;
+  auto relay = Relay::createShared(loop, mode);
+  relay->sharedRefUntil<EvRelayEnd>();
+
+  auto payload = [](std::size_t size, char base) {
+    auto buf = std::make_unique<nul::Buffer>(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      buf->getData()[i] = static_cast<char>(base + i % 26);
+    }
+    buf->setLength(size);
+    return buf;
+  };
+
+  auto relayEnded = false;
+  auto streamsClosed = 0;
+  relay->on<EvRelayEnd>([&](const auto &e, auto &r) {
+    relayEnded = true;
+    // published from the close path of the streams
+    ASSERT_EQ(streamsClosed, 2);
+    ASSERT_EQ(e.status, 0);
+    ASSERT_EQ(e.bytesAToB, kRequestSize);
+    ASSERT_EQ(e.bytesBToA, kResponseSize);
+  });
+
+  auto upstreamConnected = false;
+  auto start = [&]() {
+    if (accepted.size() < 2 || !upstreamConnected) {
+      return;
+    }
+    for (auto s : { accepted[0].get(), upstream.get() }) {
+      s->on<EvClose>([&](const auto &e, auto &s) {
+        ++streamsClosed;
+      });
+    }
+    ASSERT_TRUE(relay->start(*accepted[0], *upstream));
+    ASSERT_EQ(relay->isSplicing(), expectSplicing);
+
+    client->writeAsync(payload(kRequestSize, 'a'));
+    client->shutdown();
+    client->readStart();
+  };
+
+  // the upstream end answers once the request is complete
+  std::size_t requestReceived = 0;
+  auto onUpstreamAccepted = [&](Tcp &end) {
+    end.setAllowHalfOpen(true);
+    end.on<EvRead>([&](const auto &e, auto &end) {
+      for (ssize_t i = 0; i < e.nread; ++i) {
+        ASSERT_EQ(e.buf[i], static_cast<char>('a' + (requestReceived + i) % 26));
+      }
+      requestReceived += e.nread;
+    });
+    end.on<EvEnd>([&](const auto &e, auto &end) {
+      ASSERT_EQ(requestReceived, kRequestSize);
+      end.writeAsync(payload(kResponseSize, 'A'));
+      end.shutdown();
+    });
+    end.readStart();
+  };
+
+  std::size_t responseReceived = 0;
+  client->setAllowHalfOpen(true);
+  client->on<EvRead>([&](const auto &e, auto &c) {
+    for (ssize_t i = 0; i < e.nread; ++i) {
+      ASSERT_EQ(e.buf[i], static_cast<char>('A' + (responseReceived + i) % 26));
+    }
+    responseReceived += e.nread;
+  });
+  client->on<EvEnd>([&](const auto &e, auto &c) {
+    c.close();
+    accepted[1]->close();
+    server->close();
+  });
+
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    accepted.push_back(std::move(const_cast<EvAccept<Tcp> &>(e).client));
+    if (accepted.size() == 2) {
+      onUpstreamAccepted(*accepted[1]);
+    }
+    start();
+  });
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    // connected in order, so the client is accepted first
+    ASSERT_TRUE(upstream->connect(server->getIP(), 22334));
+  });
+  upstream->on<EvConnect>([&](const auto &e, auto &u) {
+    upstreamConnected = true;
+    start();
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22334));
+
+  loop->run();
+
+  ASSERT_TRUE(relayEnded);
+  ASSERT_EQ(requestReceived, kRequestSize);
+  ASSERT_EQ(responseReceived, kResponseSize);
+}
+
+TEST(Relay, Copy) {
+  testRelay(Relay::Mode::COPY, false);
+}
+
+TEST(Relay, Auto) {
+#if defined(__linux__)
+  testRelay(Relay::Mode::AUTO, true);
+#else
+  testRelay(Relay::Mode::AUTO, false);
+#endif
+}
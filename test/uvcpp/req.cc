@@ -41,3 +41,31 @@ TEST(Req, DNSRequest0000) {
 
   loop->run();
 }
+
+TEST(Req, ReqPool) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto &pool = ReqPool<WriteReq>::of(loop->getRaw());
+  ASSERT_EQ(&pool, &loop->getContext<ReqPool<WriteReq>>());
+
+  auto req = pool.acquire();
+  auto rawReq = req.get();
+  req->buffer = std::make_unique<nul::Buffer>(16);
+  pool.recycle(std::move(req));
+  ASSERT_EQ(pool.getFreeCount(), 1u);
+
+  // recycled requests come back without what their last use left
+  req = pool.acquire();
+  ASSERT_EQ(req.get(), rawReq);
+  ASSERT_FALSE(!!req->buffer);
+  ASSERT_EQ(pool.getFreeCount(), 0u);
+
+  // pools are per loop and per request type
+  auto otherLoop = std::make_shared<Loop>();
+  ASSERT_TRUE(otherLoop->init());
+  ASSERT_NE(&ReqPool<WriteReq>::of(otherLoop->getRaw()), &pool);
+  ASSERT_NE(
+    static_cast<void *>(&ReqPool<UdpSendReq>::of(loop->getRaw())),
+    static_cast<void *>(&pool));
+}
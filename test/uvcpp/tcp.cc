@@ -177,3 +177,915 @@ TEST(Tcp, ImmediateClose) {
 
   loop->run();
 }
+
+struct EchoHandler {
+  EchoHandler(Tcp &tcp) : tcp(tcp) { }
+
+  void onRead(const char *buf, ssize_t nread) {
+    auto reply = std::make_unique<nul::Buffer>(nread);
+    reply->assign(buf, nread);
+    tcp.writeAsync(std::move(reply), *this);
+  }
+
+  void onWrite(std::unique_ptr<nul::Buffer> buffer, int status) {
+    ASSERT_EQ(status, 0);
+    ASSERT_TRUE(!!buffer);
+    ++writeCount;
+  }
+
+  Tcp &tcp;
+  int writeCount{0};
+};
+
+struct ClientHandler {
+  void onRead(const char *buf, ssize_t nread) {
+    received.append(buf, nread);
+    if (received.size() == expected.size()) {
+      tcp->close();
+    }
+  }
+
+  void onWrite(std::unique_ptr<nul::Buffer> buffer, int status) {
+    ASSERT_EQ(status, 0);
+    ++writeCount;
+  }
+
+  Tcp *tcp{nullptr};
+  std::string expected;
+  std::string received;
+  int writeCount{0};
+};
+
+TEST(Tcp, StaticHandler) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+  ASSERT_TRUE(!!server);
+  ASSERT_TRUE(!!client);
+
+  std::shared_ptr<Tcp> acceptedClient;
+  std::unique_ptr<EchoHandler> echoHandler;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+    echoHandler = std::make_unique<EchoHandler>(*acceptedClient);
+    acceptedClient->readStart(*echoHandler);
+    acceptedClient->template on<EvClose>([&](const auto &e, auto &c) {
+      s.close();
+    });
+  });
+
+  ClientHandler clientHandler;
+  clientHandler.tcp = client.get();
+  clientHandler.expected = "greet from client!";
+  client->on<EvConnect>([&](const auto &e, auto &client) {
+    client.readStart(clientHandler);
+    auto buf = std::make_unique<nul::Buffer>(clientHandler.expected.size());
+    buf->assign(clientHandler.expected.c_str(), clientHandler.expected.size());
+    ASSERT_TRUE(client.writeAsync(std::move(buf), clientHandler));
+  });
+  client->on<EvClose>([&](const auto &e, auto &client) {
+    acceptedClient->close();
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22335));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22335));
+
+  loop->run();
+
+  ASSERT_EQ(clientHandler.received, clientHandler.expected);
+  ASSERT_EQ(clientHandler.writeCount, 1);
+  ASSERT_GE(echoHandler->writeCount, 1);
+}
+
+struct WriteCounter {
+  void onWrite(std::unique_ptr<nul::Buffer> buffer, int status) {
+    lastStatus = status;
+    lastBuffer = std::move(buffer);
+    ++writeCount;
+  }
+
+  int writeCount{0};
+  int lastStatus{0};
+  std::unique_ptr<nul::Buffer> lastBuffer{nullptr};
+};
+
+struct ShutdownReader {
+  void onRead(const char *buf, ssize_t nread) {
+    received.append(buf, nread);
+    if (received.size() == expected.size()) {
+      tcp->shutdown();
+      auto buf = std::make_unique<nul::Buffer>(1);
+      buf->assign("x", 1);
+      refused = !tcp->writeAsync(std::move(buf), refusedWriter);
+    }
+  }
+
+  Tcp *tcp{nullptr};
+  std::string expected;
+  std::string received;
+  WriteCounter refusedWriter;
+  bool refused{false};
+};
+
+TEST(Tcp, StaticWriteHandlers) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+
+  std::shared_ptr<Tcp> acceptedClient;
+  std::unique_ptr<EchoHandler> echoHandler;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+    echoHandler = std::make_unique<EchoHandler>(*acceptedClient);
+    acceptedClient->readStart(*echoHandler);
+    acceptedClient->template on<EvClose>([&](const auto &e, auto &c) {
+      s.close();
+    });
+  });
+
+  // writes with handlers of their own leave the read handler alone
+  ShutdownReader reader;
+  reader.tcp = client.get();
+  reader.expected = "head|tail";
+  WriteCounter headWriter;
+  WriteCounter tailWriter;
+  client->on<EvConnect>([&](const auto &e, auto &client) {
+    client.readStart(reader);
+    auto head = std::make_unique<nul::Buffer>(5);
+    head->assign("head|", 5);
+    ASSERT_TRUE(client.writeAsync(std::move(head), headWriter));
+    auto tail = std::make_unique<nul::Buffer>(4);
+    tail->assign("tail", 4);
+    ASSERT_TRUE(client.writeAsync(std::move(tail), tailWriter));
+  });
+  client->on<EvClose>([&](const auto &e, auto &client) {
+    acceptedClient->close();
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22344));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22344));
+
+  loop->run();
+
+  ASSERT_EQ(reader.received, reader.expected);
+  ASSERT_EQ(headWriter.writeCount, 1);
+  ASSERT_EQ(headWriter.lastStatus, 0);
+  ASSERT_EQ(tailWriter.writeCount, 1);
+  ASSERT_EQ(tailWriter.lastStatus, 0);
+  // the refused write hands its buffer back
+  ASSERT_TRUE(reader.refused);
+  ASSERT_EQ(reader.refusedWriter.writeCount, 1);
+  ASSERT_LT(reader.refusedWriter.lastStatus, 0);
+  ASSERT_TRUE(!!reader.refusedWriter.lastBuffer);
+}
+
+TEST(Tcp, VectoredWrite) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+
+  const auto parts = std::vector<std::string>{
+    "header|", std::string(10000, 'b'), "|trailer" };
+  auto expected = std::string{};
+  for (auto &p : parts) {
+    expected += p;
+  }
+
+  auto recycledCount = 0;
+  auto writeCount = 0;
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    auto buffers = BufferVector{};
+    for (auto &p : parts) {
+      auto buf = std::make_unique<nul::Buffer>(p.size());
+      buf->assign(p.c_str(), p.size());
+      buffers.push_back(std::move(buf));
+    }
+    ASSERT_TRUE(c.writeAsync(std::move(buffers)));
+  });
+  client->on<EvBufferRecycled>([&](const auto &e, auto &c) {
+    ASSERT_EQ(e.buffer->getLength(), parts[recycledCount].size());
+    ++recycledCount;
+  });
+  client->on<EvWrite>([&](const auto &e, auto &c) {
+    ++writeCount;
+    c.close();
+  });
+
+  auto received = std::string{};
+  std::shared_ptr<Tcp> acceptedClient;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    e.client->template on<EvRead>([&](const auto &e, auto &c) {
+      received.append(e.buf, e.nread);
+    });
+    e.client->template on<EvClose>([&](const auto &e, auto &c) {
+      s.close();
+    });
+    e.client->readStart();
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22334));
+
+  loop->run();
+
+  ASSERT_EQ(recycledCount, 3);
+  ASSERT_EQ(writeCount, 1);
+  ASSERT_EQ(received, expected);
+}
+
+TEST(Tcp, Cork) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+
+  auto expected = std::string{};
+  auto write = [&expected](Tcp &tcp, const std::string &msg) {
+    auto buf = std::make_unique<nul::Buffer>(msg.size());
+    buf->assign(msg.c_str(), msg.size());
+    expected += msg;
+    ASSERT_TRUE(tcp.writeAsync(std::move(buf)));
+  };
+
+  // the static write goes after the gathered buffers
+  struct CloseOnWrite {
+    void onWrite(std::unique_ptr<nul::Buffer> buffer, int status) {
+      ASSERT_EQ(status, 0);
+      ++writeCount;
+      tcp->close();
+    }
+
+    Tcp *tcp;
+    int writeCount{0};
+  } staticWriter{client.get()};
+
+  auto recycledCount = 0;
+  auto writeCount = 0;
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    // gathered until the loop polls again
+    c.setAutoCork(true);
+    for (int i = 0; i < 10; ++i) {
+      write(c, "auto" + std::to_string(i) + ",");
+    }
+  });
+  client->on<EvBufferRecycled>([&](const auto &e, auto &c) {
+    ++recycledCount;
+  });
+  client->on<EvWrite>([&](const auto &e, auto &c) {
+    if (++writeCount == 1) {
+      c.setAutoCork(false);
+      c.cork();
+      for (int i = 0; i < 3; ++i) {
+        write(c, "cork" + std::to_string(i) + ",");
+      }
+      auto buf = std::make_unique<nul::Buffer>(7);
+      buf->assign("static,", 7);
+      expected += "static,";
+      ASSERT_TRUE(c.writeAsync(std::move(buf), staticWriter));
+      ASSERT_TRUE(c.uncork());
+    }
+  });
+
+  auto received = std::string{};
+  std::shared_ptr<Tcp> acceptedClient;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    e.client->template on<EvRead>([&](const auto &e, auto &c) {
+      received.append(e.buf, e.nread);
+    });
+    e.client->template on<EvClose>([&](const auto &e, auto &c) {
+      s.close();
+    });
+    e.client->readStart();
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22334));
+
+  loop->run();
+
+  ASSERT_EQ(writeCount, 2);
+  ASSERT_EQ(staticWriter.writeCount, 1);
+  ASSERT_EQ(recycledCount, 13);
+  ASSERT_EQ(received, expected);
+}
+
+TEST(Tcp, TryWrite) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+
+  auto expected = std::string{};
+  auto write = [&expected](Tcp &tcp, const std::string &msg) {
+    auto buf = std::make_unique<nul::Buffer>(msg.size());
+    buf->assign(msg.c_str(), msg.size());
+    expected += msg;
+    ASSERT_TRUE(tcp.write(std::move(buf)));
+  };
+
+  auto recycledCount = 0;
+  auto writeCount = 0;
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    write(c, "small");
+    // written in full, no request is queued
+    ASSERT_EQ(recycledCount, 1);
+
+    // more than the socket takes at once, the rest is queued and the
+    // writes that follow are queued behind it
+    write(c, std::string(8 * 1024 * 1024, 'x'));
+    for (int i = 0; i < 10; ++i) {
+      write(c, "tail" + std::to_string(i));
+    }
+  });
+  client->on<EvBufferRecycled>([&](const auto &e, auto &c) {
+    if (++recycledCount == 12) {
+      c.close();
+    }
+  });
+  client->on<EvWrite>([&](const auto &e, auto &c) {
+    ++writeCount;
+  });
+
+  auto received = std::string{};
+  std::shared_ptr<Tcp> acceptedClient;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    e.client->template on<EvRead>([&](const auto &e, auto &c) {
+      received.append(e.buf, e.nread);
+    });
+    e.client->template on<EvClose>([&](const auto &e, auto &c) {
+      s.close();
+    });
+    e.client->readStart();
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22334));
+
+  loop->run();
+
+  ASSERT_EQ(recycledCount, 12);
+  ASSERT_EQ(writeCount, 11);
+  ASSERT_TRUE(received == expected);
+}
+
+TEST(Tcp, WriteWatermarks) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto sink = Tcp::createUnique(loop);
+  auto source = Tcp::createUnique(loop);
+  std::vector<std::shared_ptr<Tcp>> accepted;
+
+  auto isReading = [](Tcp &tcp) {
+    return reinterpret_cast<uv_stream_t *>(tcp.get())->read_cb != nullptr;
+  };
+
+  auto blockedCount = 0;
+  auto writableCount = 0;
+  auto start = [&]() {
+    if (accepted.size() < 2 || !isReading(*source)) {
+      return;
+    }
+    sink->setWriteWatermarks(64 * 1024, 16 * 1024);
+    sink->setFlowSource(source.get());
+    // nobody reads on the other end, so the queue grows
+    for (int i = 0; i < 64 && !sink->isWriteBlocked(); ++i) {
+      auto buf = std::make_unique<nul::Buffer>(1024 * 1024);
+      buf->setLength(1024 * 1024);
+      ASSERT_TRUE(sink->writeAsync(std::move(buf)));
+    }
+    ASSERT_TRUE(sink->isWriteBlocked());
+  };
+
+  sink->on<EvWriteBlocked>([&](const auto &e, auto &c) {
+    ++blockedCount;
+    ASSERT_FALSE(isReading(*source));
+    accepted[0]->template on<EvRead>([](const auto &e, auto &s) { });
+    accepted[0]->readStart();
+  });
+  sink->on<EvWritable>([&](const auto &e, auto &c) {
+    ++writableCount;
+    ASSERT_LE(c.getWriteQueueSize(), 16u * 1024);
+    ASSERT_TRUE(isReading(*source));
+
+    auto buf = std::make_unique<nul::Buffer>(2);
+    buf->assign("hi", 2);
+    accepted[1]->writeAsync(std::move(buf));
+  });
+  source->on<EvRead>([&](const auto &e, auto &c) {
+    ASSERT_EQ(std::string(e.buf, e.nread), "hi");
+    sink->setFlowSource(nullptr);
+    for (auto &a : accepted) {
+      a->close();
+    }
+    sink->close();
+    source->close();
+    server->close();
+  });
+
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    accepted.push_back(std::move(const_cast<EvAccept<Tcp> &>(e).client));
+    start();
+  });
+  sink->on<EvConnect>([&](const auto &e, auto &c) {
+    // connected in order, so the sink is accepted first
+    ASSERT_TRUE(source->connect(server->getIP(), 22334));
+  });
+  source->on<EvConnect>([&](const auto &e, auto &c) {
+    c.readStart();
+    start();
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(sink->connect(server->getIP(), 22334));
+
+  loop->run();
+
+  ASSERT_EQ(blockedCount, 1);
+  ASSERT_EQ(writableCount, 1);
+}
+
+TEST(Tcp, SendFile) {
+  const std::size_t kFileSize = 3 * 1024 * 1024 + 123;
+  const std::size_t kOffset = 10;
+
+  char path[] = "/tmp/uvcpp_sendfile_XXXXXX";
+  auto fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  unlink(path);
+  auto content = std::string(kFileSize, '\0');
+  for (std::size_t i = 0; i < kFileSize; ++i) {
+    content[i] = static_cast<char>(i & 0x7f);
+  }
+  ASSERT_EQ(::write(fd, content.data(), kFileSize),
+            static_cast<ssize_t>(kFileSize));
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto client = Tcp::createUnique(loop);
+
+  auto write = [](Tcp &tcp, const std::string &msg) {
+    auto buf = std::make_unique<nul::Buffer>(msg.size());
+    buf->assign(msg.c_str(), msg.size());
+    ASSERT_TRUE(tcp.writeAsync(std::move(buf)));
+  };
+
+  std::shared_ptr<Tcp> acceptedClient;
+  WriteCounter refusedWriter;
+  std::uint64_t progress = 0;
+  auto sendFileStatus = 1;
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    // the socket takes less than a chunk at a time
+    int sndBuf = 16 * 1024;
+    c.setSockOption(
+      SO_SNDBUF, reinterpret_cast<void *>(&sndBuf), sizeof(sndBuf));
+    write(c, "head");
+    ASSERT_TRUE(c.sendFile(fd, kOffset, kFileSize - kOffset));
+    ASSERT_FALSE(c.sendFile(fd, 0, 1));
+    // held back until the file is sent
+    write(c, "tail");
+    // would overtake the file, handed back
+    auto buf = std::make_unique<nul::Buffer>(1);
+    buf->assign("x", 1);
+    ASSERT_FALSE(c.writeAsync(std::move(buf), refusedWriter));
+    c.shutdown();
+  });
+  client->on<EvSendFileProgress>([&](const auto &e, auto &c) {
+    ASSERT_GT(e.sent, progress);
+    ASSERT_EQ(e.length, kFileSize - kOffset);
+    progress = e.sent;
+  });
+  client->on<EvSendFile>([&](const auto &e, auto &c) {
+    sendFileStatus = e.status;
+    ASSERT_EQ(e.sent, kFileSize - kOffset);
+    ASSERT_FALSE(c.isSendingFile());
+  });
+
+  auto received = std::string{};
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    e.client->template on<EvRead>([&](const auto &e, auto &c) {
+      received.append(e.buf, e.nread);
+    });
+    e.client->template on<EvClose>([&](const auto &e, auto &c) {
+      client->close();
+      s.close();
+    });
+    e.client->readStart();
+    acceptedClient = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  ASSERT_TRUE(client->connect(server->getIP(), 22334));
+
+  loop->run();
+  close(fd);
+
+  ASSERT_EQ(sendFileStatus, 0);
+  ASSERT_EQ(progress, kFileSize - kOffset);
+  ASSERT_TRUE(received == "head" + content.substr(kOffset) + "tail");
+  ASSERT_EQ(refusedWriter.writeCount, 1);
+  ASSERT_EQ(refusedWriter.lastStatus, UV_EAGAIN);
+  ASSERT_TRUE(!!refusedWriter.lastBuffer);
+}
+
+TEST(Tcp, PooledAccept) {
+  const int kConnections = 5;
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  server->setPooledAccept(true);
+
+  std::vector<Tcp *> acceptedPtrs;
+  std::unique_ptr<Tcp> accepted;
+  std::vector<std::unique_ptr<Tcp>> clients;
+  auto connections = 0;
+  std::function<void()> connect;
+
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    accepted = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+    acceptedPtrs.push_back(accepted.get());
+    ASSERT_EQ(accepted->getIP(), "127.0.0.1");
+    SockAddrStorage local;
+    int len = sizeof(local);
+    uv_tcp_getsockname(
+      clients.back()->get(), reinterpret_cast<SockAddr *>(&local), &len);
+    ASSERT_EQ(accepted->getPort(),
+              NetUtil::port(reinterpret_cast<SockAddr *>(&local)));
+
+    // nothing of the previous connection is left
+    accepted->on<EvRead>([&](const auto &e, auto &c) {
+      ASSERT_EQ(std::string(e.buf, e.nread), "x");
+      c.close();
+    });
+    accepted->on<EvClose>([&](const auto &e, auto &c) {
+      Tcp::recycle(std::move(accepted));
+      if (++connections < kConnections) {
+        connect();
+      } else {
+        s.close();
+      }
+    });
+    accepted->readStart();
+  });
+
+  connect = [&]() {
+    auto client = Tcp::createUnique(loop);
+    client->on<EvConnect>([](const auto &e, auto &c) {
+      auto buf = std::make_unique<nul::Buffer>(1);
+      buf->assign("x", 1);
+      c.writeAsync(std::move(buf));
+      c.readStart();
+    });
+    ASSERT_TRUE(client->connect("127.0.0.1", 22334));
+    clients.push_back(std::move(client));
+  };
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+  connect();
+
+  loop->run();
+
+  ASSERT_EQ(connections, kConnections);
+  for (auto p : acceptedPtrs) {
+    ASSERT_EQ(p, acceptedPtrs[0]);
+  }
+
+  // the pooled Tcp is freed with the loop rather than keeping it alive
+  std::weak_ptr<Loop> weakLoop = loop;
+  clients.clear();
+  server.reset();
+  loop.reset();
+  ASSERT_TRUE(weakLoop.expired());
+}
+
+TEST(Tcp, BatchedAccept) {
+  const int kClients = 6;
+  const int kAdmitted = 3;
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  std::vector<std::unique_ptr<Tcp>> accepted;
+  std::vector<std::unique_ptr<Tcp>> clients;
+
+  auto admissions = 0;
+  auto closedClients = 0;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    ASSERT_EQ(e.client->getIP(), "127.0.0.1");
+    accepted.push_back(std::move(const_cast<EvAccept<Tcp> &>(e).client));
+  });
+
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  server->setSockOption(
+    SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  // two per iteration, the first three peers get in
+  ASSERT_TRUE(server->listenBatched(50, 2, [&](const SockAddr *peer) {
+    EXPECT_EQ(NetUtil::ip(peer), "127.0.0.1");
+    return ++admissions <= kAdmitted;
+  }));
+
+  for (int i = 0; i < kClients; ++i) {
+    auto client = Tcp::createUnique(loop);
+    client->on<EvConnect>([](const auto &e, auto &c) {
+      c.readStart();
+    });
+    // the rejected ones are closed by the server, the others here
+    client->on<EvClose>([&](const auto &e, auto &c) {
+      if (++closedClients == kClients) {
+        for (auto &a : accepted) {
+          a->close();
+        }
+        server->close();
+      }
+    });
+    client->on<EvError>([](const auto &e, auto &c) { });
+    ASSERT_TRUE(client->connect("127.0.0.1", 22334));
+    clients.push_back(std::move(client));
+  }
+
+  auto rejectedClosed = false;
+  auto timer = Timer::createUnique(loop);
+  timer->on<EvTimer>([&](const auto &e, auto &t) {
+    ASSERT_EQ(admissions, kClients);
+    ASSERT_EQ(accepted.size(), static_cast<std::size_t>(kAdmitted));
+    rejectedClosed = closedClients == kClients - kAdmitted;
+    for (auto &c : clients) {
+      c->close();
+    }
+    t.close();
+  });
+  timer->start(100, 0);
+
+  loop->run();
+
+  ASSERT_TRUE(rejectedClosed);
+  ASSERT_EQ(closedClients, kClients);
+}
+
+TEST(Tcp, SocketOptions) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  // no socket yet, options fail without closing the handle
+  auto unspec = Tcp::createUnique(loop);
+  ASSERT_FALSE(unspec->setNotSentLowat(16384));
+  ASSERT_TRUE(unspec->isValid());
+  unspec->close();
+
+  auto tcp = Tcp::createUnique(loop, Tcp::Domain::INET);
+  auto getInt = [&](int level, int option) {
+    int value = -1;
+    socklen_t len = sizeof(value);
+    EXPECT_TRUE(tcp->getSockOption(level, option, &value, &len));
+    return value;
+  };
+
+  ASSERT_TRUE(tcp->setNotSentLowat(16384));
+  ASSERT_EQ(getInt(IPPROTO_TCP, TCP_NOTSENT_LOWAT), 16384);
+  ASSERT_TRUE(tcp->setUserTimeout(5000));
+  ASSERT_EQ(getInt(IPPROTO_TCP, TCP_USER_TIMEOUT), 5000);
+  tcp->setKeepAlive(true, 30);
+  ASSERT_EQ(getInt(IPPROTO_TCP, TCP_KEEPIDLE), 30);
+  ASSERT_TRUE(tcp->setKeepAliveInterval(7));
+  ASSERT_EQ(getInt(IPPROTO_TCP, TCP_KEEPINTVL), 7);
+  ASSERT_TRUE(tcp->setKeepAliveCount(3));
+  ASSERT_EQ(getInt(IPPROTO_TCP, TCP_KEEPCNT), 3);
+  ASSERT_TRUE(tcp->setSendBufferSize(65536));
+  ASSERT_GE(getInt(SOL_SOCKET, SO_SNDBUF), 65536);
+  ASSERT_TRUE(tcp->setRecvBufferSize(65536));
+  ASSERT_GE(getInt(SOL_SOCKET, SO_RCVBUF), 65536);
+  ASSERT_TRUE(tcp->setQuickAck(true));
+  ASSERT_TRUE(tcp->setFastOpenConnect(true));
+  ASSERT_TRUE(tcp->isValid());
+  tcp->close();
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->setFastOpen(16));
+  ASSERT_TRUE(server->listen(16));
+  server->close();
+
+  loop->run();
+}
+
+TEST(Tcp, TcpInfo) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  std::unique_ptr<Tcp> conn;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    conn = std::move(const_cast<EvAccept<Tcp> &>(e).client);
+  });
+  int on = 1;
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+
+  auto samples = 0;
+  auto client = Tcp::createUnique(loop);
+  client->on<EvConnect>([&](const auto &e, auto &c) {
+    TcpInfo info;
+    ASSERT_TRUE(c.getTcpInfo(&info));
+    ASSERT_EQ(info.state, TCP_ESTABLISHED);
+    ASSERT_GT(info.mss, 0u);
+    ASSERT_GT(info.cwnd, 0u);
+
+    Tcp::setTcpInfoInterval(*loop, 10);
+    c.setTcpInfoSampling(true);
+  });
+  client->on<EvTcpInfo>([&](const auto &e, auto &c) {
+    ASSERT_EQ(e.info.state, TCP_ESTABLISHED);
+    if (++samples == 3) {
+      c.close();
+      conn->close();
+      server->close();
+    }
+  });
+  ASSERT_TRUE(client->connect("127.0.0.1", 22334));
+
+  // the sampling timer alone does not keep the loop running
+  loop->run();
+  ASSERT_EQ(samples, 3);
+}
+
+TEST(Tcp, Timeouts) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  // never accepts, with a backlog of one the SYNs beyond it go unanswered
+  SockAddrStorage sas;
+  NetUtil::convertIPAddress("127.0.0.1", 22342, &sas);
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_NE(fd, -1);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  ASSERT_EQ(
+    bind(fd, reinterpret_cast<SockAddr *>(&sas), sizeof(SockAddr4)), 0);
+  ASSERT_EQ(::listen(fd, 0), 0);
+
+  std::vector<std::unique_ptr<Tcp>> fillers;
+  for (int i = 0; i < 3; ++i) {
+    fillers.push_back(Tcp::createUnique(loop));
+    fillers.back()->on<EvError>([](const auto &e, auto &c) { });
+    ASSERT_TRUE(fillers.back()->connect("127.0.0.1", 22342));
+  }
+
+  std::vector<EvTimeout::Type> timeouts;
+  auto closed = 0;
+  auto onTimeout = [&](const auto &e, auto &s) {
+    timeouts.push_back(e.type);
+  };
+  auto onClose = [&](const auto &e, auto &s) {
+    // the connect, the idle and the read timeout
+    if (++closed == 3) {
+      for (auto &f : fillers) {
+        f->close();
+      }
+    }
+  };
+
+  auto pending = Tcp::createUnique(loop);
+  pending->setConnectTimeout(100);
+  pending->on<EvTimeout>(onTimeout);
+  pending->on<EvClose>(onClose);
+  pending->on<EvConnect>([](const auto &e, auto &c) {
+    FAIL() << "the backlog should be full";
+  });
+  pending->on<EvError>([](const auto &e, auto &c) {
+    ASSERT_EQ(e.status, UV_ECANCELED);
+  });
+
+  auto server = Tcp::createUnique(loop, Tcp::Domain::INET);
+  std::vector<std::unique_ptr<Tcp>> accepted;
+  auto reads = 0;
+  server->on<EvAccept<Tcp>>([&](const auto &e, auto &s) {
+    accepted.push_back(std::move(const_cast<EvAccept<Tcp> &>(e).client));
+    auto &conn = accepted.back();
+    conn->template on<EvTimeout>(onTimeout);
+    conn->template on<EvClose>(onClose);
+    if (accepted.size() == 1) {
+      conn->setIdleTimeout(150);
+    } else {
+      // pushed back by each of the reads
+      conn->template on<EvRead>([&](const auto &e, auto &c) { ++reads; });
+      conn->setReadTimeout(150);
+      conn->readStart();
+      s.close();
+    }
+  });
+  server->setSockOption(
+    SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+  ASSERT_TRUE(server->bind("127.0.0.1", 22334));
+  ASSERT_TRUE(server->listen(50));
+
+  auto idleClient = Tcp::createUnique(loop);
+  auto busyClient = Tcp::createUnique(loop);
+  auto timer = Timer::createUnique(loop);
+  auto writes = 0;
+  timer->on<EvTimer>([&](const auto &e, auto &t) {
+    if (++writes == 4) {
+      t.close();
+    }
+    auto buf = std::make_unique<nul::Buffer>(1);
+    buf->assign("x", 1);
+    busyClient->writeAsync(std::move(buf));
+  });
+  busyClient->on<EvConnect>([&](const auto &e, auto &c) {
+    timer->start(50, 50);
+  });
+  for (auto c : { idleClient.get(), busyClient.get() }) {
+    c->on<EvClose>([](const auto &e, auto &c) { });
+    c->on<EvRead>([](const auto &e, auto &c) { });
+    c->on<EvConnect>([](const auto &e, auto &c) { c.readStart(); });
+  }
+  ASSERT_TRUE(idleClient->connect("127.0.0.1", 22334));
+  ASSERT_TRUE(pending->connect("127.0.0.1", 22342));
+  ASSERT_TRUE(busyClient->connect("127.0.0.1", 22334));
+
+  loop->run();
+  ::close(fd);
+
+  ASSERT_EQ(closed, 3);
+  ASSERT_EQ(timeouts, (std::vector<EvTimeout::Type>{
+    EvTimeout::Type::CONNECT, EvTimeout::Type::IDLE,
+    EvTimeout::Type::READ }));
+  ASSERT_EQ(reads, 4);
+}
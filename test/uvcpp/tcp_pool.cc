@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+
+using namespace uvcpp;
+
+class TcpPoolTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+      loop = std::make_shared<Loop>();
+      ASSERT_TRUE(loop->init());
+      server = Tcp::createUnique(loop, Tcp::Domain::INET);
+      server->on<EvAccept<Tcp>>([this](const auto &e, auto &s) {
+        accepted.push_back(std::move(const_cast<EvAccept<Tcp> &>(e).client));
+      });
+
+      int on = 1;
+      server->setSockOption(
+        SO_REUSEADDR, reinterpret_cast<void *>(&on), sizeof(on));
+      server->setSockOption(
+        SO_REUSEPORT, reinterpret_cast<void *>(&on), sizeof(on));
+      ASSERT_TRUE(server->bind("127.0.0.1", 22339));
+      ASSERT_TRUE(server->listen(50));
+      NetUtil::convertIPAddress("127.0.0.1", 22339, &addr);
+    }
+
+    void TearDown() override {
+      TcpConnectionPool::of(loop).clear();
+      for (auto &a : accepted) {
+        a->close();
+      }
+      server->close();
+      loop->run();
+    }
+
+    const SockAddr *getAddr() {
+      return reinterpret_cast<const SockAddr *>(&addr);
+    }
+
+    std::shared_ptr<Loop> loop;
+    std::unique_ptr<Tcp> server;
+    std::vector<std::unique_ptr<Tcp>> accepted;
+    SockAddrStorage addr;
+};
+
+TEST_F(TcpPoolTest, Reuse) {
+  auto &pool = TcpConnectionPool::of(loop);
+  Tcp *first = nullptr;
+  auto acquired = 0;
+
+  pool.acquire(getAddr(), [&](std::unique_ptr<Tcp> tcp, int status) {
+    ASSERT_EQ(status, 0);
+    first = tcp.get();
+    ++acquired;
+    tcp->on<EvRead>([](const auto &e, auto &t) { });
+    pool.release(std::move(tcp));
+    ASSERT_EQ(pool.getIdleCount(getAddr()), 1u);
+
+    // the idle one is handed back right away, without its subscriptions
+    pool.acquire(getAddr(), [&](std::unique_ptr<Tcp> tcp, int status) {
+      ASSERT_EQ(status, 0);
+      ASSERT_EQ(tcp.get(), first);
+      ++acquired;
+      pool.release(std::move(tcp));
+      loop->stop();
+    });
+  });
+  loop->run();
+
+  ASSERT_EQ(acquired, 2);
+  ASSERT_EQ(pool.getTotalCount(getAddr()), 1u);
+}
+
+TEST_F(TcpPoolTest, EvictAndLimits) {
+  auto &pool = TcpConnectionPool::of(loop);
+  pool.setMaxTotal(1);
+  pool.setIdleTimeout(50);
+
+  auto waiterServed = false;
+  pool.acquire(getAddr(), [&](std::unique_ptr<Tcp> tcp, int status) {
+    ASSERT_EQ(status, 0);
+    auto first = tcp.get();
+
+    // at the limit, served once the leased one is released
+    pool.acquire(getAddr(), [&, first](std::unique_ptr<Tcp> tcp, int status) {
+      ASSERT_EQ(tcp.get(), first);
+      waiterServed = true;
+      pool.release(std::move(tcp));
+    });
+    ASSERT_FALSE(waiterServed);
+    pool.release(std::move(tcp));
+    ASSERT_TRUE(waiterServed);
+    ASSERT_EQ(pool.getIdleCount(getAddr()), 1u);
+
+    // EOF from the peer evicts the idle connection
+    accepted.back()->close();
+  });
+
+  auto timer = Timer::createUnique(loop);
+  auto ticks = 0;
+  timer->on<EvTimer>([&](const auto &e, auto &t) {
+    ASSERT_EQ(pool.getIdleCount(getAddr()), 0u);
+    ASSERT_EQ(pool.getTotalCount(getAddr()), 0u);
+    if (++ticks == 2) {
+      t.close();
+      loop->stop();
+      return;
+    }
+
+    // the next one is dialed and closed after the idle timeout
+    pool.acquire(getAddr(), [&](std::unique_ptr<Tcp> tcp, int status) {
+      ASSERT_EQ(status, 0);
+      pool.release(std::move(tcp));
+      ASSERT_EQ(pool.getIdleCount(getAddr()), 1u);
+    });
+  });
+  timer->start(100, 200);
+
+  loop->run();
+
+  ASSERT_TRUE(waiterServed);
+  ASSERT_EQ(pool.getIdleCount(getAddr()), 0u);
+  ASSERT_EQ(pool.getTotalCount(getAddr()), 0u);
+}
+
+TEST_F(TcpPoolTest, ReleaseResetsSettings) {
+  auto &pool = TcpConnectionPool::of(loop);
+  auto timedOut = false;
+
+  pool.acquire(getAddr(), [&](std::unique_ptr<Tcp> tcp, int status) {
+    ASSERT_EQ(status, 0);
+    tcp->on<EvTimeout>([&](const auto &e, auto &t) {
+      timedOut = true;
+    });
+    tcp->setIdleTimeout(30);
+    tcp->setWriteWatermarks(1, 0);
+    pool.release(std::move(tcp));
+  });
+
+  // the idle timeout of the lease would have closed it by now
+  auto timer = Timer::createUnique(loop);
+  timer->on<EvTimer>([&](const auto &e, auto &t) {
+    ASSERT_EQ(pool.getIdleCount(getAddr()), 1u);
+    pool.acquire(getAddr(), [&](std::unique_ptr<Tcp> tcp, int status) {
+      ASSERT_EQ(status, 0);
+      ASSERT_FALSE(tcp->isWriteBlocked());
+      pool.release(std::move(tcp));
+    });
+    t.close();
+    loop->stop();
+  });
+  timer->start(300, 0);
+
+  loop->run();
+  ASSERT_FALSE(timedOut);
+}
+
+TEST(TcpPool, FreedWithLoop) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  // completes the handshakes without ever accepting
+  SockAddrStorage sas;
+  NetUtil::convertIPAddress("127.0.0.1", 22343, &sas);
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_NE(fd, -1);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  ASSERT_EQ(
+    bind(fd, reinterpret_cast<SockAddr *>(&sas), sizeof(SockAddr4)), 0);
+  ASSERT_EQ(::listen(fd, 8), 0);
+
+  auto &pool = TcpConnectionPool::of(loop);
+  pool.acquire(
+    reinterpret_cast<SockAddr *>(&sas),
+    [&](std::unique_ptr<Tcp> tcp, int status) {
+      ASSERT_EQ(status, 0);
+      pool.release(std::move(tcp));
+      loop->stop();
+    });
+  loop->run();
+  ASSERT_EQ(pool.getIdleCount(reinterpret_cast<SockAddr *>(&sas)), 1u);
+
+  // left connecting, its callback goes away with the pool
+  auto called = false;
+  ASSERT_TRUE(pool.acquire(
+      "127.0.0.1", 22341, [&](std::unique_ptr<Tcp> tcp, int status) {
+        called = true;
+      }));
+
+  // neither the idle nor the connecting one keeps the loop alive
+  std::weak_ptr<Loop> weakLoop = loop;
+  loop.reset();
+  ASSERT_TRUE(weakLoop.expired());
+  ASSERT_FALSE(called);
+  ::close(fd);
+}
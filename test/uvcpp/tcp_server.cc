@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+#include <atomic>
+
+using namespace uvcpp;
+
+void testServerGroup(TcpServerGroup::Steering steering) {
+  const int kLoops = 2;
+  const int kClients = 20;
+
+  std::atomic<int> accepted{0};
+  std::atomic<int> stopped{0};
+  TcpServerGroup group{
+    kLoops,
+    [&accepted](Tcp &server, std::size_t index) {
+      // each connection gets the index of its loop and is closed
+      server.on<EvAccept<Tcp>>([&accepted, index](const auto &e, auto &s) {
+        std::shared_ptr<Tcp> client = std::move(
+          const_cast<EvAccept<Tcp> &>(e).client);
+        client->template sharedRefUntil<EvClose>();
+        client->template on<EvWrite>([](const auto &e, auto &c) {
+          c.close();
+        });
+        auto buf = std::make_unique<nul::Buffer>(1);
+        buf->getData()[0] = static_cast<char>('0' + index);
+        buf->setLength(1);
+        client->writeAsync(std::move(buf));
+        ++accepted;
+      });
+    },
+    [&stopped](Loop &loop, std::size_t index) {
+      ++stopped;
+    }
+  };
+  ASSERT_TRUE(group.start("127.0.0.1", 22338, 128, steering));
+  ASSERT_TRUE(group.isRunning());
+  ASSERT_FALSE(group.start("127.0.0.1", 22338));
+
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+  std::vector<std::unique_ptr<Tcp>> clients;
+  auto replies = std::string{};
+  for (int i = 0; i < kClients; ++i) {
+    auto client = Tcp::createUnique(loop);
+    client->on<EvRead>([&replies](const auto &e, auto &c) {
+      replies.append(e.buf, e.nread);
+    });
+    client->on<EvConnect>([](const auto &e, auto &c) {
+      c.readStart();
+    });
+    ASSERT_TRUE(client->connect("127.0.0.1", 22338));
+    clients.push_back(std::move(client));
+  }
+  loop->run();
+
+  group.stop();
+  ASSERT_FALSE(group.isRunning());
+
+  ASSERT_EQ(accepted, kClients);
+  ASSERT_EQ(stopped, kLoops);
+  ASSERT_EQ(replies.size(), static_cast<std::size_t>(kClients));
+  for (auto c : replies) {
+    ASSERT_TRUE(c >= '0' && c < '0' + kLoops);
+  }
+}
+
+TEST(TcpServer, Group) {
+  testServerGroup(TcpServerGroup::Steering::NONE);
+}
+
+TEST(TcpServer, CpuSteering) {
+  testServerGroup(TcpServerGroup::Steering::CPU);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "uvcpp.h"
+
+using namespace uvcpp;
+
+namespace {
+  // the wheel does not keep the loop running, this does until it is empty
+  void keepAlive(const std::shared_ptr<Loop> &loop, TimerWheel &wheel) {
+    auto timer = Timer::createShared(loop);
+    timer->sharedRefUntil<EvClose>();
+    timer->on<EvTimer>([&wheel](const auto &e, auto &t) {
+      if (wheel.size() == 0) {
+        t.close();
+      }
+    });
+    timer->start(5, 5);
+  }
+}
+
+TEST(TimerWheel, FireInOrder) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto &wheel = TimerWheel::of(*loop);
+  ASSERT_TRUE(wheel.setGranularity(2));
+
+  std::vector<int> order;
+  struct Ctx {
+    std::vector<int> *order;
+    int id;
+    uint64_t scheduledAt;
+    uint64_t timeout;
+    Loop *loop;
+  };
+  // 80, 4 and 40 ticks, the first one is cascaded from the second level
+  const uint64_t timeouts[] = { 160, 8, 80 };
+  Ctx ctx[3];
+  TimerWheelEntry entries[3];
+  for (int i = 0; i < 3; ++i) {
+    ctx[i] = Ctx{
+      &order, i, uv_now(loop->getRaw()), timeouts[i], loop.get() };
+    entries[i].setCallback([](TimerWheelEntry *entry) {
+      auto c = reinterpret_cast<Ctx *>(entry->getData());
+      // never early
+      EXPECT_GE(uv_now(c->loop->getRaw()) - c->scheduledAt, c->timeout);
+      c->order->push_back(c->id);
+    }, &ctx[i]);
+    wheel.schedule(entries[i], timeouts[i]);
+  }
+  ASSERT_EQ(wheel.size(), 3u);
+  keepAlive(loop, wheel);
+
+  loop->run();
+  ASSERT_EQ(order, (std::vector<int>{ 1, 2, 0 }));
+  ASSERT_FALSE(entries[0].isScheduled());
+}
+
+TEST(TimerWheel, CancelAndReschedule) {
+  auto loop = std::make_shared<Loop>();
+  ASSERT_TRUE(loop->init());
+
+  auto &wheel = TimerWheel::of(*loop);
+  ASSERT_TRUE(wheel.setGranularity(5));
+
+  auto cancelled = 0;
+  auto pushed = 0;
+  TimerWheelEntry cancelledEntry{
+    [](TimerWheelEntry *e) { ++*reinterpret_cast<int *>(e->getData()); },
+    &cancelled };
+  TimerWheelEntry pushedEntry{
+    [](TimerWheelEntry *e) { ++*reinterpret_cast<int *>(e->getData()); },
+    &pushed };
+  wheel.schedule(cancelledEntry, 20);
+  wheel.schedule(pushedEntry, 20);
+  {
+    // destroyed entries cancel themselves
+    TimerWheelEntry gone{
+      [](TimerWheelEntry *e) { FAIL() << "destroyed entry fired"; },
+      nullptr };
+    wheel.schedule(gone, 10);
+  }
+  ASSERT_EQ(wheel.size(), 2u);
+  cancelledEntry.cancel();
+  ASSERT_EQ(wheel.size(), 1u);
+
+  // pushed back like a read timeout on every read, until it is let go
+  auto resets = 0;
+  auto timer = Timer::createShared(loop);
+  timer->sharedRefUntil<EvClose>();
+  timer->on<EvTimer>([&](const auto &e, auto &t) {
+    if (++resets < 5) {
+      ASSERT_EQ(pushed, 0);
+      wheel.schedule(pushedEntry, 20);
+      ASSERT_EQ(wheel.size(), 1u);
+    } else if (wheel.size() == 0) {
+      t.close();
+    }
+  });
+  timer->start(10, 10);
+
+  loop->run();
+  ASSERT_EQ(cancelled, 0);
+  ASSERT_EQ(pushed, 1);
+  ASSERT_GE(resets, 5);
+}